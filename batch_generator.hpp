@@ -0,0 +1,239 @@
+#ifndef _BATCH_GENERATOR_HPP_
+#define _BATCH_GENERATOR_HPP_
+
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "generation_cache.hpp"
+#include "grammar.hpp"
+#include "grammar_loader.hpp"
+#include "parse_table_generator.hpp"
+#include "table_writer.hpp"
+
+// Default number of tables that may be written at the same time in a batch
+const static int DEFAULT_BATCH_IO_JOBS = 2;
+
+// A grammar file and the path to write its table to
+struct BatchJob {
+  std::string grammar_path;
+  std::string output_path;
+};
+
+// The outcome of a BatchJob
+struct BatchResult {
+  bool ok = false;
+
+  // True if the table was read from the cache instead of generated
+  bool cached = false;
+
+  // The error for a failed job
+  std::string message;
+};
+
+/**
+ * Reads a batch manifest
+ *
+ * Each line holds a grammar file and the path to write its table to,
+ * separated by whitespace. Blank lines and lines starting with # are skipped.
+ *
+ *  grammars/config.grammar  tables/config.out
+ *  grammars/query.grammar   tables/query.out
+ *
+ * Relative paths are used as given
+ * Throws GrammarLoadError if the manifest can't be read or a line is malformed
+ */
+std::vector<BatchJob> read_batch_manifest(const std::string& path) {
+  std::ifstream in_stream(path);
+  if(!in_stream) {
+    throw GrammarLoadError(path, 0, 0, strerror(errno));
+  }
+
+  std::vector<BatchJob> jobs;
+  std::string line;
+  int line_num = 0;
+  while(std::getline(in_stream, line)) {
+    ++line_num;
+
+    std::stringstream stream(line);
+    BatchJob job;
+    std::string extra;
+    if(!(stream >> job.grammar_path) || job.grammar_path[0] == COMMENT_CHAR) {
+      continue;
+    }
+
+    if(!(stream >> job.output_path) || (stream >> extra)) {
+      throw GrammarLoadError(path, line_num, 1, "expected a grammar file and an output path");
+    }
+
+    jobs.push_back(job);
+  }
+
+  return jobs;
+}
+
+/**
+ * Generates the tables for many grammars in one process
+ *
+ * Jobs are spread over a pool of worker threads that each take the next
+ * job as soon as they are free. Each worker keeps a single TableWriter, so
+ * its output buffer is allocated once and reused for every table it writes.
+ *
+ * Tables are generated in memory and at most io_jobs workers write
+ * their output at the same time, so a wide pool does not flood the disk.
+ *
+ * With a cache, each grammar is looked up before it is generated
+ * and stored after, the same as a single run.
+ */
+class BatchGenerator {
+  public:
+    BatchGenerator(int jobs, int io_jobs = DEFAULT_BATCH_IO_JOBS, GenerationCache* cache = nullptr, const GeneratorOptions& options = GeneratorOptions()) :
+      jobs(std::max(jobs, 1)),
+      io_slots(std::max(io_jobs, 1)),
+      cache(cache),
+      options(options) {}
+
+    /**
+     * Runs every job in batch and returns their results in the same order
+     *
+     * on_done is called from the worker threads, one job at a time,
+     * as each job finishes
+     */
+    std::vector<BatchResult> run(const std::vector<BatchJob>& batch, const std::function<void(const BatchJob&, const BatchResult&)>& on_done = nullptr) {
+      std::vector<BatchResult> results(batch.size());
+      std::atomic<size_t> next_job(0);
+      std::mutex done_mutex;
+
+      auto worker = [&]() {
+        TableWriter writer;
+
+        for(size_t i = next_job++; i < batch.size(); i = next_job++) {
+          results[i] = generate(batch[i], writer);
+
+          if(on_done) {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            on_done(batch[i], results[i]);
+          }
+        }
+      };
+
+      std::vector<std::thread> workers;
+      int worker_count = std::min<size_t>(jobs, batch.size());
+      for(int i = 1; i < worker_count; ++i) {
+        workers.emplace_back(worker);
+      }
+
+      // The calling thread is one of the workers
+      worker();
+
+      for(std::thread& thread : workers) {
+        thread.join();
+      }
+
+      return results;
+    }
+
+  private:
+    // Number of worker threads
+    int jobs;
+
+    // Number of workers that may be writing a table at the same time
+    int io_slots;
+    std::mutex io_mutex;
+    std::condition_variable io_cv;
+
+    // Shared by all workers, may be null
+    GenerationCache* cache;
+
+    // The generator options, applied to every table
+    GeneratorOptions options;
+
+    // Loads, generates and writes the table for one job
+    BatchResult generate(const BatchJob& job, TableWriter& writer) {
+      BatchResult result;
+
+      try {
+        Grammar grammar = load_grammar_file(job.grammar_path);
+        if(options.prune_grammar) {
+          grammar.remove_useless_productions();
+        }
+        grammar.add_augmented_production();
+        const std::shared_ptr<const Grammar> snapshot = Grammar::make_snapshot(std::move(grammar));
+
+        CachedGeneration generation;
+        std::string cache_key;
+        if(cache) {
+          cache_key = GenerationCache::make_key(*snapshot, options.to_string());
+          result.cached = cache->load(cache_key, generation);
+        }
+
+        if(!result.cached) {
+          LR1ParserTableGenerator generator(snapshot);
+          generator.set_memory_budget(options.memory_budget);
+          generator.set_abort_on_conflict(options.abort_on_conflict);
+          generator.set_keep_conflicts(options.keep_conflicts);
+          generator.set_try_slr(options.try_slr);
+          generator.build_parse_table();
+          generator.run_table_passes(options);
+
+          if(cache) {
+            generation = CachedGeneration::capture(generator);
+            cache->store(cache_key, generation);
+          }
+          else {
+            generation.cols = generator.get_table_columns();
+            generation.table = generator.release_parse_table();
+          }
+        }
+
+        acquire_io_slot();
+        bool written = writer.open(job.output_path);
+        if(written) {
+          writer.write_header(generation.cols);
+          for(const auto& row : generation.table) {
+            writer.write_row(row);
+          }
+          written = writer.close();
+        }
+        release_io_slot();
+
+        if(!written) {
+          result.message = "failed to write " + job.output_path + ": " + writer.get_error();
+          return result;
+        }
+      }
+      catch(const std::exception& e) {
+        result.message = e.what();
+        return result;
+      }
+
+      result.ok = true;
+      return result;
+    }
+
+    void acquire_io_slot() {
+      std::unique_lock<std::mutex> lock(io_mutex);
+      io_cv.wait(lock, [this]() { return io_slots > 0; });
+      --io_slots;
+    }
+
+    void release_io_slot() {
+      {
+        std::lock_guard<std::mutex> lock(io_mutex);
+        ++io_slots;
+      }
+      io_cv.notify_one();
+    }
+};
+
+#endif /* _BATCH_GENERATOR_HPP_ */
@@ -0,0 +1,840 @@
+#ifndef _CONSTEXPR_TABLE_HPP_
+#define _CONSTEXPR_TABLE_HPP_
+
+/**
+ * Builds the LR(1) parse table of a grammar written in source at
+ * compile time
+ *
+ * The grammar is an array of production strings like G2 in main.cpp,
+ * with %left, %right, %nonassoc and %prec as in Grammar:
+ *
+ *  constexpr std::string_view CALC[] = {
+ *    "%left '+'",
+ *    "E -> E '+' E",
+ *    "E -> 'NUM'",
+ *  };
+ *  constexpr auto CALC_TABLE = make_constexpr_table<CALC>();
+ *  static_assert(CALC_TABLE.accepts(...));
+ *
+ * FIRST sets, closures, GOTO and the table are the same algorithms
+ * as SetGenerator and LR1ParserTableGenerator, on fixed size arrays,
+ * so nothing is allocated and the table is a constant that ends up in
+ * read only data. States are numbered the same way, so the table
+ * is the one set_generator writes for the grammar.
+ *
+ * The array sizes are set by ConstexprLimits. Going over a limit, or
+ * a malformed production, throws, which fails the compile at the throw.
+ * The compiler also caps how much constant evaluation one expression may
+ * do. A grammar the size of G2 needs it raised past GCC's default,
+ * e.g. -fconstexpr-ops-limit=67108864, and takes seconds to compile.
+ *
+ * Needs C++20. With an earlier standard the header is empty.
+ */
+#if __cplusplus >= 202002L
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Capacities of the arrays ConstexprTableGenerator works in
+struct ConstexprLimits {
+  // Symbols in productions, counting $ and S'
+  size_t symbols = 64;
+
+  // Productions, counting S' -> S
+  size_t productions = 64;
+
+  // Symbols on the rhs of one production
+  size_t rhs = 8;
+
+  // Precedence declarations, one per terminal declared
+  size_t precedences = 32;
+
+  // Items in one item set, closure included
+  size_t items = 256;
+
+  size_t states = 256;
+
+  // Kernel items of all item sets together
+  size_t kernel_items = 4096;
+};
+
+enum class ConstexprActionKind : uint8_t {
+  ERROR,
+  SHIFT,
+  REDUCE,
+  ACCEPT,
+  GOTO
+};
+
+// A table entry, like {SHIFT, 5} for s5
+struct ConstexprAction {
+  ConstexprActionKind kind = ConstexprActionKind::ERROR;
+  uint16_t number = 0;
+
+  // Returns the entry as LR1ParserTableGenerator writes it: s5, r3, acct, 7 or ""
+  std::string to_string() const {
+    switch(kind) {
+      case ConstexprActionKind::SHIFT: return "s" + std::to_string(number);
+      case ConstexprActionKind::REDUCE: return "r" + std::to_string(number);
+      case ConstexprActionKind::ACCEPT: return "acct";
+      case ConstexprActionKind::GOTO: return std::to_string(number);
+      default: return "";
+    }
+  }
+};
+
+/**
+ * A parse table built at compile time by make_constexpr_table
+ *
+ * Columns are in the order of LR1ParserTableGenerator: the terminals,
+ * $, then the non-terminals. Production 0 is S' -> S.
+ */
+template<size_t STATES, size_t COLS, size_t PRODUCTIONS>
+struct ConstexprParseTable {
+  std::array<std::string_view, COLS> cols{};
+  std::array<std::array<ConstexprAction, COLS>, STATES> rows{};
+
+  // The goto column of the lhs of each production
+  std::array<uint16_t, PRODUCTIONS> lhs_cols{};
+
+  // The number of symbols each production reduces
+  std::array<uint16_t, PRODUCTIONS> rhs_sizes{};
+
+  size_t dollar_col = 0;
+
+  // Conflicts that precedence didn't resolve, resolved like
+  // LR1ParserTableGenerator::fill_row does
+  size_t shift_reduce_conflicts = 0;
+  size_t reduce_reduce_conflicts = 0;
+
+  // Returns the column of symbol or -1 if it is not in the table
+  constexpr int get_column(std::string_view symbol) const {
+    for(size_t i = 0; i < COLS; ++i) {
+      if(cols[i] == symbol) {
+        return i;
+      }
+    }
+
+    return -1;
+  }
+
+  /**
+   * Returns true if tokens, terminals like 'ID' '=' 'ID', are a sentence
+   * of the grammar. Runs the same algorithm as LRParser::parse, on a
+   * stack of at most MAX_DEPTH states
+   *
+   * Throws std::length_error if the stack would grow past MAX_DEPTH
+   */
+  template<size_t MAX_DEPTH = 256>
+  constexpr bool accepts(std::span<const std::string_view> tokens) const {
+    std::array<uint16_t, MAX_DEPTH> stack{};
+    size_t depth = 1;
+
+    size_t position = 0;
+    while(true) {
+      const int col = position < tokens.size() ? get_column(tokens[position]) : dollar_col;
+      if(col < 0 || (position < tokens.size() && col == dollar_col)) {
+        return false;
+      }
+
+      const ConstexprAction& action = rows[stack[depth - 1]][col];
+      if(action.kind == ConstexprActionKind::SHIFT) {
+        if(depth == MAX_DEPTH) {
+          throw std::length_error("parse stack is deeper than MAX_DEPTH");
+        }
+        stack[depth++] = action.number;
+        ++position;
+      }
+      else if(action.kind == ConstexprActionKind::REDUCE) {
+        depth -= rhs_sizes[action.number];
+
+        const ConstexprAction& goto_action = rows[stack[depth - 1]][lhs_cols[action.number]];
+        if(goto_action.kind != ConstexprActionKind::GOTO || depth == MAX_DEPTH) {
+          throw std::length_error("parse stack is deeper than MAX_DEPTH");
+        }
+        stack[depth++] = goto_action.number;
+      }
+      else {
+        return action.kind == ConstexprActionKind::ACCEPT;
+      }
+    }
+  }
+
+  template<size_t N>
+  constexpr bool accepts(const std::string_view (&tokens)[N]) const {
+    return accepts(std::span<const std::string_view>(tokens));
+  }
+};
+
+/**
+ * Generates the LR(1) item sets and parse table of a grammar in
+ * constant expressions
+ *
+ * The constructor does all the work. Symbols are numbered by their
+ * table column, with S' after the last column.
+ */
+template<ConstexprLimits LIMITS>
+class ConstexprTableGenerator {
+  public:
+    constexpr ConstexprTableGenerator(std::span<const std::string_view> source) {
+      read_grammar(source);
+      build_first_sets();
+      build_item_sets();
+    }
+
+    constexpr size_t get_state_count() const {
+      return state_count;
+    }
+
+    constexpr size_t get_col_count() const {
+      return col_count;
+    }
+
+    constexpr size_t get_production_count() const {
+      return production_count;
+    }
+
+    // Copies the table into table, which has the sizes above
+    template<typename Table>
+    constexpr void copy_table(Table& table) const {
+      for(size_t col = 0; col < col_count; ++col) {
+        table.cols[col] = names[col];
+      }
+
+      for(size_t state = 0; state < state_count; ++state) {
+        for(size_t col = 0; col < col_count; ++col) {
+          table.rows[state][col] = rows[state][col];
+        }
+      }
+
+      for(size_t p = 0; p < production_count; ++p) {
+        table.lhs_cols[p] = productions[p].lhs;
+        table.rhs_sizes[p] = productions[p].rhs_size;
+      }
+
+      table.dollar_col = dollar;
+      table.shift_reduce_conflicts = shift_reduce_conflicts;
+      table.reduce_reduce_conflicts = reduce_reduce_conflicts;
+    }
+
+  private:
+    // Associativities as in Grammar
+    enum class Associativity : uint8_t {
+      NONE,
+      LEFT,
+      RIGHT,
+      NONASSOC
+    };
+
+    struct Production {
+      uint16_t lhs = 0;
+      std::array<uint16_t, LIMITS.rhs> rhs{};
+      uint16_t rhs_size = 0;
+
+      // The terminal named by %prec, or empty
+      std::string_view precedence_symbol;
+    };
+
+    struct Precedence {
+      std::string_view symbol;
+      uint16_t level = 0;
+      Associativity associativity = Associativity::NONE;
+    };
+
+    // [A → α ⋅ β, t] as production, position of the marker and t
+    struct Item {
+      uint16_t production = 0;
+      uint16_t position = 0;
+      uint16_t lookahead = 0;
+
+      constexpr bool operator<(const Item& other) const {
+        if(production != other.production) {
+          return production < other.production;
+        }
+        if(position != other.position) {
+          return position < other.position;
+        }
+        return lookahead < other.lookahead;
+      }
+
+      constexpr bool operator==(const Item& other) const = default;
+    };
+
+    // A set of terminal columns, a bit per column
+    using TerminalSet = std::array<uint64_t, (LIMITS.symbols + 63) / 64>;
+
+    std::array<std::string_view, LIMITS.symbols> names{};
+    std::array<bool, LIMITS.symbols> terminal{};
+    size_t symbol_count = 0;
+
+    std::array<Production, LIMITS.productions> productions{};
+    size_t production_count = 0;
+
+    std::array<Precedence, LIMITS.precedences> precedences{};
+    size_t precedence_count = 0;
+
+    // Columns: terminals [0, dollar), $, non-terminals (dollar, col_count)
+    // and S' is symbol col_count
+    size_t dollar = 0;
+    size_t col_count = 0;
+
+    std::array<TerminalSet, LIMITS.symbols> first_sets{};
+    std::array<bool, LIMITS.symbols> nullable{};
+
+    // The kernel of state i is kernel_pool[kernel_starts[i], kernel_starts[i + 1])
+    std::array<Item, LIMITS.kernel_items> kernel_pool{};
+    std::array<size_t, LIMITS.states + 1> kernel_starts{};
+    std::array<uint64_t, LIMITS.states> kernel_hashes{};
+    size_t state_count = 0;
+
+    // The states by the hash of their kernel, as state number + 1
+    std::array<uint16_t, std::bit_ceil(2 * LIMITS.states)> kernel_index{};
+
+    std::array<std::array<ConstexprAction, LIMITS.symbols>, LIMITS.states> rows{};
+
+    size_t shift_reduce_conflicts = 0;
+    size_t reduce_reduce_conflicts = 0;
+
+    // Same rule as is_terminal in grammar.hpp
+    static constexpr bool is_terminal_name(std::string_view symbol) {
+      if(symbol.size() < 3 || symbol.front() != '\'' || symbol.back() != '\'') {
+        return false;
+      }
+
+      return symbol.find_first_of(" \t\r\n\f\v") == std::string_view::npos;
+    }
+
+    static constexpr std::string_view trim(std::string_view str) {
+      while(!str.empty() && str.front() == ' ') {
+        str.remove_prefix(1);
+      }
+      while(!str.empty() && str.back() == ' ') {
+        str.remove_suffix(1);
+      }
+
+      return str;
+    }
+
+    // Splits str on spaces into pieces, returning how many there are
+    template<size_t N>
+    static constexpr size_t split(std::string_view str, std::array<std::string_view, N>& pieces) {
+      size_t count = 0;
+      while(!str.empty()) {
+        const size_t end = std::min(str.find(' '), str.size());
+        if(end > 0) {
+          if(count == N) {
+            throw std::length_error("production has more symbols than ConstexprLimits::rhs");
+          }
+          pieces[count++] = str.substr(0, end);
+        }
+        str.remove_prefix(std::min(end + 1, str.size()));
+      }
+
+      return count;
+    }
+
+    constexpr uint16_t intern_symbol(std::string_view symbol) {
+      for(size_t i = 0; i < symbol_count; ++i) {
+        if(names[i] == symbol) {
+          return i;
+        }
+      }
+
+      if(symbol_count == LIMITS.symbols) {
+        throw std::length_error("grammar has more symbols than ConstexprLimits::symbols");
+      }
+      names[symbol_count] = symbol;
+      terminal[symbol_count] = is_terminal_name(symbol);
+      return symbol_count++;
+    }
+
+    /**
+     * Reads the productions and precedence declarations of source
+     * the way Grammar does, adds S' -> S for the lhs of the first
+     * production and renumbers the symbols by column
+     */
+    constexpr void read_grammar(std::span<const std::string_view> source) {
+      // Production 0 is S' -> S, filled in below
+      production_count = 1;
+      uint16_t level = 0;
+
+      for(std::string_view line : source) {
+        std::array<std::string_view, LIMITS.rhs + 2> pieces{};
+
+        if(line.starts_with("%left") || line.starts_with("%right") || line.starts_with("%nonassoc")) {
+          const size_t count = split(line, pieces);
+          const Associativity associativity = pieces[0] == "%left" ? Associativity::LEFT :
+            pieces[0] == "%right" ? Associativity::RIGHT : Associativity::NONASSOC;
+
+          ++level;
+          for(size_t i = 1; i < count; ++i) {
+            if(!is_terminal_name(pieces[i])) {
+              throw std::invalid_argument("precedence can only be declared for terminals");
+            }
+            if(precedence_count == LIMITS.precedences) {
+              throw std::length_error("grammar has more precedences than ConstexprLimits::precedences");
+            }
+            precedences[precedence_count++] = {pieces[i], level, associativity};
+          }
+          continue;
+        }
+
+        const size_t arrow = line.find("->");
+        if(arrow == std::string_view::npos) {
+          throw std::invalid_argument("production has no ->");
+        }
+        if(production_count == LIMITS.productions) {
+          throw std::length_error("grammar has more productions than ConstexprLimits::productions");
+        }
+
+        Production& production = productions[production_count++];
+        production.lhs = intern_symbol(trim(line.substr(0, arrow)));
+
+        const size_t count = split(line.substr(arrow + 2), pieces);
+        for(size_t i = 0; i < count; ++i) {
+          // Skip empty set symbol since it is just a placeholder
+          if(pieces[i] == "~") {
+            continue;
+          }
+
+          if(pieces[i] == "%prec") {
+            if(i != count - 2 || !is_terminal_name(pieces[i + 1])) {
+              throw std::invalid_argument("%prec must be followed by a terminal at the end of a production");
+            }
+            production.precedence_symbol = pieces[i + 1];
+            break;
+          }
+
+          if(production.rhs_size == LIMITS.rhs) {
+            throw std::length_error("production has more symbols than ConstexprLimits::rhs");
+          }
+          production.rhs[production.rhs_size++] = intern_symbol(pieces[i]);
+        }
+      }
+
+      if(production_count == 1) {
+        throw std::invalid_argument("grammar has no productions");
+      }
+
+      productions[0].lhs = intern_symbol("S'");
+      productions[0].rhs[0] = productions[1].lhs;
+      productions[0].rhs_size = 1;
+      const uint16_t augmented = productions[0].lhs;
+      const uint16_t dollar_symbol = intern_symbol("$");
+      terminal[dollar_symbol] = true;
+
+      // Sorted terminals, $, sorted non-terminals, S'
+      std::array<uint16_t, LIMITS.symbols> order{};
+      for(size_t i = 0; i < symbol_count; ++i) {
+        order[i] = i;
+      }
+      std::sort(order.begin(), order.begin() + symbol_count, [&](uint16_t a, uint16_t b) {
+        const int group_a = a == augmented ? 3 : a == dollar_symbol ? 1 : terminal[a] ? 0 : 2;
+        const int group_b = b == augmented ? 3 : b == dollar_symbol ? 1 : terminal[b] ? 0 : 2;
+        return group_a != group_b ? group_a < group_b : names[a] < names[b];
+      });
+
+      std::array<uint16_t, LIMITS.symbols> cols{};
+      std::array<std::string_view, LIMITS.symbols> sorted_names{};
+      std::array<bool, LIMITS.symbols> sorted_terminal{};
+      for(size_t i = 0; i < symbol_count; ++i) {
+        cols[order[i]] = i;
+        sorted_names[i] = names[order[i]];
+        sorted_terminal[i] = terminal[order[i]];
+      }
+      names = sorted_names;
+      terminal = sorted_terminal;
+
+      for(size_t p = 0; p < production_count; ++p) {
+        productions[p].lhs = cols[productions[p].lhs];
+        for(size_t i = 0; i < productions[p].rhs_size; ++i) {
+          productions[p].rhs[i] = cols[productions[p].rhs[i]];
+        }
+      }
+
+      dollar = cols[dollar_symbol];
+      col_count = symbol_count - 1;
+    }
+
+    static constexpr void add_all(TerminalSet& set, const TerminalSet& other) {
+      for(size_t i = 0; i < set.size(); ++i) {
+        set[i] |= other[i];
+      }
+    }
+
+    static constexpr void add(TerminalSet& set, size_t col) {
+      set[col / 64] |= uint64_t(1) << (col % 64);
+    }
+
+    static constexpr bool contains(const TerminalSet& set, size_t col) {
+      return (set[col / 64] >> (col % 64)) & 1;
+    }
+
+    // FIRST(X) of each non-terminal, Dragon book 4.4.2, repeated until
+    // no set changes. A terminal's FIRST set is itself
+    constexpr void build_first_sets() {
+      bool changed = true;
+      while(changed) {
+        changed = false;
+
+        for(size_t p = 0; p < production_count; ++p) {
+          const Production& production = productions[p];
+          TerminalSet first = first_sets[production.lhs];
+          bool all_nullable = true;
+
+          for(size_t i = 0; i < production.rhs_size && all_nullable; ++i) {
+            const uint16_t symbol = production.rhs[i];
+            if(terminal[symbol]) {
+              add(first, symbol);
+              all_nullable = false;
+            }
+            else {
+              add_all(first, first_sets[symbol]);
+              all_nullable = nullable[symbol];
+            }
+          }
+
+          if(first != first_sets[production.lhs] || (all_nullable && !nullable[production.lhs])) {
+            first_sets[production.lhs] = first;
+            nullable[production.lhs] = nullable[production.lhs] || all_nullable;
+            changed = true;
+          }
+        }
+      }
+    }
+
+    // Adds FIRST(β) to set, where β is the rhs of production from
+    // position from on. Returns true if β is nullable
+    constexpr bool add_first(const Production& production, size_t from, TerminalSet& set) const {
+      for(size_t i = from; i < production.rhs_size; ++i) {
+        const uint16_t symbol = production.rhs[i];
+        if(terminal[symbol]) {
+          add(set, symbol);
+          return false;
+        }
+
+        add_all(set, first_sets[symbol]);
+        if(!nullable[symbol]) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    // Hashes the count items of kernel for kernel_index
+    static constexpr uint64_t hash_kernel(const Item* kernel, size_t count) {
+      uint64_t hash = 14695981039346656037ULL;
+      for(size_t i = 0; i < count; ++i) {
+        for(uint16_t value : {kernel[i].production, kernel[i].position, kernel[i].lookahead}) {
+          hash ^= value;
+          hash *= 1099511628211ULL;
+        }
+      }
+
+      return hash;
+    }
+
+    // Returns the state with the count items of kernel,
+    // adding it if it is new
+    constexpr uint16_t add_item_set(const Item* kernel, size_t count) {
+      const uint64_t hash = hash_kernel(kernel, count);
+
+      // Open addressing, kernel_index is kept at most half full
+      size_t slot = hash % kernel_index.size();
+      for(; kernel_index[slot] != 0; slot = (slot + 1) % kernel_index.size()) {
+        const size_t state = kernel_index[slot] - 1;
+        const size_t start = kernel_starts[state];
+        if(kernel_hashes[state] == hash && kernel_starts[state + 1] - start == count &&
+           std::equal(kernel, kernel + count, kernel_pool.begin() + start)) {
+          return state;
+        }
+      }
+
+      if(state_count == LIMITS.states) {
+        throw std::length_error("grammar has more states than ConstexprLimits::states");
+      }
+      if(kernel_starts[state_count] + count > LIMITS.kernel_items) {
+        throw std::length_error("grammar has more kernel items than ConstexprLimits::kernel_items");
+      }
+
+      std::copy(kernel, kernel + count, kernel_pool.begin() + kernel_starts[state_count]);
+      kernel_starts[state_count + 1] = kernel_starts[state_count] + count;
+      kernel_hashes[state_count] = hash;
+      kernel_index[slot] = state_count + 1;
+      return state_count++;
+    }
+
+    /**
+     * Builds all item sets breadth first like SetGenerator::build_item_sets,
+     * filling the row of each state once its gotos are known
+     */
+    constexpr void build_item_sets() {
+      // The productions of each non-terminal
+      std::array<uint16_t, LIMITS.productions> by_lhs{};
+      std::array<size_t, LIMITS.symbols + 1> lhs_starts{};
+      for(size_t p = 0; p < production_count; ++p) {
+        ++lhs_starts[productions[p].lhs + 1];
+      }
+      for(size_t i = 0; i < symbol_count; ++i) {
+        lhs_starts[i + 1] += lhs_starts[i];
+      }
+      std::array<size_t, LIMITS.symbols + 1> next_slot = lhs_starts;
+      for(size_t p = 0; p < production_count; ++p) {
+        by_lhs[next_slot[productions[p].lhs]++] = p;
+      }
+
+      // The place of each symbol in name order, which is the order
+      // SetGenerator takes the gotos of a state in
+      std::array<uint16_t, LIMITS.symbols> by_name{};
+      std::array<uint16_t, LIMITS.symbols> name_rank{};
+      for(size_t i = 0; i < symbol_count; ++i) {
+        by_name[i] = i;
+      }
+      std::sort(by_name.begin(), by_name.begin() + symbol_count, [&](uint16_t a, uint16_t b) {
+        return names[a] < names[b];
+      });
+      for(size_t i = 0; i < symbol_count; ++i) {
+        name_rank[by_name[i]] = i;
+      }
+
+      const Item start = {0, 0, (uint16_t)dollar};
+      add_item_set(&start, 1);
+
+      for(size_t state = 0; state < state_count; ++state) {
+        // The state's kernel and then its closure, Dragon book 4.7.2
+        std::array<Item, LIMITS.items> items{};
+        size_t count = kernel_starts[state + 1] - kernel_starts[state];
+        std::copy(kernel_pool.begin() + kernel_starts[state], kernel_pool.begin() + kernel_starts[state + 1], items.begin());
+
+        // The closure adds [B → ⋅ γ, b] for every production of B and
+        // every b in lookaheads[B], so the lookaheads are gathered per
+        // non-terminal first, repeated until no set grows
+        std::array<TerminalSet, LIMITS.symbols> lookaheads{};
+        std::array<uint16_t, LIMITS.symbols> pending{};
+        std::array<bool, LIMITS.symbols> queued{};
+        size_t pending_count = 0;
+
+        auto add_lookaheads = [&](uint16_t b_symbol, const TerminalSet& set) {
+          bool grew = false;
+          for(size_t word = 0; word < set.size(); ++word) {
+            const uint64_t bits = lookaheads[b_symbol][word] | set[word];
+            grew = grew || bits != lookaheads[b_symbol][word];
+            lookaheads[b_symbol][word] = bits;
+          }
+
+          if(grew && !queued[b_symbol]) {
+            queued[b_symbol] = true;
+            pending[pending_count++] = b_symbol;
+          }
+        };
+
+        // [A → α ⋅ B β, t] adds FIRST(βt) to the lookaheads of B
+        for(size_t i = 0; i < count; ++i) {
+          const Production& production = productions[items[i].production];
+          if(items[i].position == production.rhs_size || terminal[production.rhs[items[i].position]]) {
+            continue;
+          }
+
+          TerminalSet first{};
+          if(add_first(production, items[i].position + 1, first)) {
+            add(first, items[i].lookahead);
+          }
+          add_lookaheads(production.rhs[items[i].position], first);
+        }
+
+        // [B → ⋅ C δ, b] adds FIRST(δb) to the lookaheads of C
+        while(pending_count > 0) {
+          const uint16_t b_symbol = pending[--pending_count];
+          queued[b_symbol] = false;
+
+          for(size_t j = lhs_starts[b_symbol]; j < lhs_starts[b_symbol + 1]; ++j) {
+            const Production& production = productions[by_lhs[j]];
+            if(production.rhs_size == 0 || terminal[production.rhs[0]]) {
+              continue;
+            }
+
+            TerminalSet first{};
+            if(add_first(production, 1, first)) {
+              add_all(first, lookaheads[b_symbol]);
+            }
+            add_lookaheads(production.rhs[0], first);
+          }
+        }
+
+        // Only the start item has its marker at 0 in a kernel, and S'
+        // is on no rhs, so none of these are in the kernel already
+        for(size_t b_symbol = 0; b_symbol < symbol_count; ++b_symbol) {
+          for(size_t j = lhs_starts[b_symbol]; j < lhs_starts[b_symbol + 1]; ++j) {
+            for(size_t word = 0; word < lookaheads[b_symbol].size(); ++word) {
+              for(uint64_t bits = lookaheads[b_symbol][word]; bits != 0; bits &= bits - 1) {
+                if(count == LIMITS.items) {
+                  throw std::length_error("an item set has more items than ConstexprLimits::items");
+                }
+                items[count++] = {by_lhs[j], 0, (uint16_t)(word * 64 + std::countr_zero(bits))};
+              }
+            }
+          }
+        }
+
+        // The items with a marker before a symbol X, moved past it, are
+        // the kernel of GOTO(Istate, X). They are bucketed by X in name
+        // order, and each kernel sorted by insertion since it is small
+        std::array<size_t, LIMITS.symbols + 1> move_starts{};
+        for(size_t i = 0; i < count; ++i) {
+          const Production& production = productions[items[i].production];
+          if(items[i].position < production.rhs_size) {
+            ++move_starts[name_rank[production.rhs[items[i].position]] + 1];
+          }
+        }
+        for(size_t i = 0; i < symbol_count; ++i) {
+          move_starts[i + 1] += move_starts[i];
+        }
+
+        std::array<Item, LIMITS.items> moves{};
+        std::array<size_t, LIMITS.symbols + 1> move_ends = move_starts;
+        for(size_t i = 0; i < count; ++i) {
+          const Production& production = productions[items[i].production];
+          if(items[i].position < production.rhs_size) {
+            size_t& end = move_ends[name_rank[production.rhs[items[i].position]]];
+            Item moved = items[i];
+            ++moved.position;
+
+            size_t j = end++;
+            for(; j > 0 && j > move_starts[name_rank[production.rhs[items[i].position]]] && moved < moves[j - 1]; --j) {
+              moves[j] = moves[j - 1];
+            }
+            moves[j] = moved;
+          }
+        }
+
+        std::array<uint16_t, LIMITS.symbols> gotos{};
+        std::array<bool, LIMITS.symbols> has_goto{};
+        for(size_t rank = 0; rank < symbol_count; ++rank) {
+          if(move_starts[rank] == move_starts[rank + 1]) {
+            continue;
+          }
+
+          const uint16_t x = by_name[rank];
+          gotos[x] = add_item_set(moves.data() + move_starts[rank], move_starts[rank + 1] - move_starts[rank]);
+          has_goto[x] = true;
+        }
+
+        fill_row(rows[state], items, count, gotos, has_goto);
+      }
+    }
+
+    constexpr Precedence get_precedence(std::string_view symbol) const {
+      for(size_t i = 0; i < precedence_count; ++i) {
+        if(precedences[i].symbol == symbol) {
+          return precedences[i];
+        }
+      }
+
+      return Precedence();
+    }
+
+    // The %prec terminal of production p, or else its last terminal
+    constexpr Precedence get_production_precedence(size_t p) const {
+      const Production& production = productions[p];
+      if(!production.precedence_symbol.empty()) {
+        return get_precedence(production.precedence_symbol);
+      }
+
+      for(size_t i = production.rhs_size; i > 0; --i) {
+        if(terminal[production.rhs[i - 1]]) {
+          return get_precedence(names[production.rhs[i - 1]]);
+        }
+      }
+
+      return Precedence();
+    }
+
+    /**
+     * Fills row from the items of a state and its gotos, resolving
+     * conflicts the same way as LR1ParserTableGenerator::fill_row
+     */
+    constexpr void fill_row(std::array<ConstexprAction, LIMITS.symbols>& row, const std::array<Item, LIMITS.items>& items, size_t count,
+                            const std::array<uint16_t, LIMITS.symbols>& gotos, const std::array<bool, LIMITS.symbols>& has_goto) {
+      for(size_t i = 0; i < count; ++i) {
+        const Item& item = items[i];
+        if(item.position != productions[item.production].rhs_size) {
+          continue;
+        }
+
+        if(item.production == 0) {
+          row[dollar] = {ConstexprActionKind::ACCEPT, 0};
+          continue;
+        }
+
+        ConstexprAction& action = row[item.lookahead];
+        if(action.kind == ConstexprActionKind::ACCEPT) {
+          continue;
+        }
+        if(action.kind == ConstexprActionKind::REDUCE) {
+          ++reduce_reduce_conflicts;
+          if(action.number < item.production) {
+            continue;
+          }
+        }
+        action = {ConstexprActionKind::REDUCE, item.production};
+      }
+
+      for(size_t x = 0; x < col_count; ++x) {
+        if(!has_goto[x]) {
+          continue;
+        }
+
+        ConstexprAction& action = row[x];
+        if(!terminal[x]) {
+          action = {ConstexprActionKind::GOTO, gotos[x]};
+          continue;
+        }
+
+        if(action.kind == ConstexprActionKind::REDUCE) {
+          const Precedence production = get_production_precedence(action.number);
+          const Precedence symbol = get_precedence(names[x]);
+
+          if(production.level == 0 || symbol.level == 0) {
+            ++shift_reduce_conflicts;
+          }
+          else if(production.level > symbol.level ||
+                  (production.level == symbol.level && symbol.associativity == Associativity::LEFT)) {
+            continue;
+          }
+          else if(production.level == symbol.level && symbol.associativity == Associativity::NONASSOC) {
+            action = ConstexprAction();
+            continue;
+          }
+        }
+
+        action = {ConstexprActionKind::SHIFT, gotos[x]};
+      }
+    }
+};
+
+/**
+ * Returns the parse table of the grammar in SOURCE, an array of
+ * production strings with static storage, built at compile time
+ *
+ *  constexpr auto table = make_constexpr_table<G, ConstexprLimits{.states = 512}>();
+ */
+template<const auto& SOURCE, ConstexprLimits LIMITS = ConstexprLimits()>
+constexpr auto make_constexpr_table() {
+  constexpr ConstexprTableGenerator<LIMITS> generator(SOURCE);
+
+  ConstexprParseTable<generator.get_state_count(), generator.get_col_count(), generator.get_production_count()> table;
+  generator.copy_table(table);
+  return table;
+}
+
+#endif /* __cplusplus >= 202002L */
+
+#endif /* _CONSTEXPR_TABLE_HPP_ */
@@ -0,0 +1,594 @@
+#ifndef _GENERATION_CACHE_HPP_
+#define _GENERATION_CACHE_HPP_
+
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "grammar.hpp"
+#include "lr1_item.hpp"
+#include "parse_table_generator.hpp"
+#include "state_store.hpp"
+
+// Bumped whenever the layout of a cache entry changes so old entries
+// are never read back with the wrong layout
+const static uint32_t CACHE_FORMAT_VERSION = 3;
+
+// Magic bytes at the start of every cache entry
+const static std::string CACHE_MAGIC = "SGC1";
+
+// File extension of finished cache entries
+const static std::string CACHE_EXTENSION = ".sgc";
+
+// Default upper bound on the total size of a cache directory
+const static uintmax_t DEFAULT_CACHE_MAX_BYTES = 256 * 1024 * 1024;
+
+// Temporary files older than this were left behind by a writer that
+// died before renaming them and can be removed
+const static std::chrono::hours CACHE_STALE_TMP_AGE(1);
+
+/**
+ * An LR(1) item stored without its production text
+ * The production is looked up again in the grammar by production_num
+ */
+struct CachedItem {
+  int production_num;
+  int position;
+  std::string lookahead;
+};
+
+/**
+ * Everything produced by a run of LR1ParserTableGenerator that
+ * is worth keeping between runs
+ */
+struct CachedGeneration {
+  // The table symbols in column order
+  std::vector<std::string> cols;
+
+  // The parse table as returned by build_parse_table
+  std::vector<std::vector<std::string>> table;
+
+  // The item sets in state order
+  std::vector<std::vector<CachedItem>> item_sets;
+
+  // The goto mappings of the form "<input set index>,<input symbol>" => "<output set index>"
+  std::unordered_map<std::string, int> goto_indices;
+
+  // The conflicts precedence did not resolve, so a cached run
+  // warns about and reports them the same as the run that built it
+  std::vector<Conflict> conflicts;
+
+  // Takes the results out of a generator that has built its table
+  // The table is moved out, see LR1ParserTableGenerator::release_parse_table
+  static CachedGeneration capture(LR1ParserTableGenerator& generator) {
+    CachedGeneration generation;
+    generation.cols = generator.get_table_columns();
+    generation.table = generator.release_parse_table();
+    generation.conflicts = generator.get_conflicts();
+
+    // One state at a time, since states may have been moved out of memory
+    for(int state = 0; state < generator.get_state_count(); ++state) {
+      for(const auto& entry : generator.get_gotos(state)) {
+        generation.goto_indices[std::to_string(state) + "," + entry.first] = entry.second;
+      }
+
+      const std::set<LR1Item, LR1Comparator>& item_set = generator.get_item_set(state);
+      std::vector<CachedItem> items;
+      items.reserve(item_set.size());
+      for(const LR1Item& item : item_set) {
+        items.push_back({item.get_production_num(), item.get_position(), item.get_lookahead()});
+      }
+      generation.item_sets.push_back(std::move(items));
+    }
+
+    return generation;
+  }
+
+  // Rebuilds the item sets against grammar, which must be
+  // the grammar the generation was captured from
+  std::vector<std::set<LR1Item, LR1Comparator>> build_item_sets(const Grammar& grammar) const {
+    std::vector<std::set<LR1Item, LR1Comparator>> sets;
+    sets.reserve(item_sets.size());
+
+    for(const auto& items : item_sets) {
+      std::set<LR1Item, LR1Comparator> item_set;
+      for(const CachedItem& item : items) {
+        item_set.insert(LR1Item(grammar[item.production_num], item.production_num, item.lookahead, item.position));
+      }
+      sets.push_back(std::move(item_set));
+    }
+
+    return sets;
+  }
+};
+
+/**
+ * A content addressed cache of generated tables on disk
+ *
+ * Entries are keyed by the normalized grammar productions and the
+ * generator options. Each entry is a single file in a compact binary
+ * form, named by a hash of its key. The entry holds the whole key, so
+ * two keys with the same hash never read each other's entry. Entries are written to a temporary file and renamed into place,
+ * so readers in other processes only ever see complete entries and
+ * several build jobs can share one cache directory.
+ *
+ * When the directory grows past max_bytes the least recently
+ * used entries are removed.
+ */
+class GenerationCache {
+  public:
+    GenerationCache(const std::string& dir, uintmax_t max_bytes = DEFAULT_CACHE_MAX_BYTES) : dir(dir), max_bytes(max_bytes) {
+      std::error_code error;
+      std::filesystem::create_directories(this->dir, error);
+    }
+
+    /**
+     * Returns the cache key for grammar built with the given options
+     *
+     * Productions are normalized first so that spacing differences
+     * like "A->B  'c'" and "A -> B 'c'" give the same key
+     * Precedence declarations are part of the key
+     */
+    static std::string make_key(const Grammar& grammar, const std::string& options) {
+      std::string key = std::to_string(CACHE_FORMAT_VERSION);
+      key += "\n" + options + "\n";
+
+      for(size_t i = 0; i < grammar.size(); ++i) {
+        const Production& production = grammar.get_production(i);
+
+        std::string normalized = grammar.get_symbol(production.lhs) + " " + RULE_SEP;
+        for(int symbol : production.rhs) {
+          normalized += " " + grammar.get_symbol(symbol);
+        }
+        if(production.rhs.empty()) {
+          normalized += " " + EPSILON;
+        }
+        key += normalized + "\n";
+      }
+
+      // Precedence decides how conflicts are resolved
+      key += grammar.get_precedence_str();
+      return key;
+    }
+
+    // Returns the short id entries for key are named by, a hash of key
+    static std::string get_key_id(const std::string& key) {
+      char id[17];
+      snprintf(id, sizeof(id), "%016llx", (unsigned long long)fnv1a(FNV_OFFSET_BASIS, key));
+      return id;
+    }
+
+    /**
+     * Loads the entry for key into generation
+     * Returns false on a miss, including an entry for another key
+     * with the same id, or if the entry could not be read
+     */
+    bool load(const std::string& key, CachedGeneration& generation) {
+      const std::filesystem::path path = get_entry_path(key);
+      std::ifstream in_stream(path, std::ios::binary);
+
+      if(!in_stream) {
+        return false;
+      }
+
+      // A damaged entry is a miss, whatever it fails with
+      try {
+        std::string data((std::istreambuf_iterator<char>(in_stream)), std::istreambuf_iterator<char>());
+        if(!decode(data, key, generation)) {
+          return false;
+        }
+      }
+      catch(const std::exception&) {
+        return false;
+      }
+
+      // Mark the entry as recently used so pruning keeps it
+      std::error_code error;
+      std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+      return true;
+    }
+
+    /**
+     * Writes generation as the entry for key, replacing any existing entry,
+     * then prunes the cache back under its size limit
+     * Returns false if the entry could not be written
+     */
+    bool store(const std::string& key, const CachedGeneration& generation) {
+      const std::filesystem::path path = get_entry_path(key);
+      const std::filesystem::path tmp_path = get_tmp_path(key);
+
+      std::string data = encode(key, generation);
+      {
+        std::ofstream out_stream(tmp_path, std::ios::binary | std::ios::trunc);
+        if(!out_stream) {
+          return false;
+        }
+
+        out_stream.write(data.data(), data.size());
+        out_stream.close();
+        if(!out_stream) {
+          std::error_code error;
+          std::filesystem::remove(tmp_path, error);
+          return false;
+        }
+      }
+
+      // rename replaces path atomically
+      std::error_code error;
+      std::filesystem::rename(tmp_path, path, error);
+      if(error) {
+        std::filesystem::remove(tmp_path, error);
+        return false;
+      }
+
+      prune();
+      return true;
+    }
+
+    /**
+     * Removes the least recently used entries until the directory
+     * is no larger than max_bytes
+     *
+     * Other processes may be pruning at the same time, so entries that
+     * disappear while this runs are skipped
+     */
+    void prune() {
+      struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type time;
+        uintmax_t size;
+      };
+
+      std::vector<Entry> entries;
+      uintmax_t total = 0;
+      const auto now = std::filesystem::file_time_type::clock::now();
+
+      std::error_code error;
+      for(const auto& file : std::filesystem::directory_iterator(dir, error)) {
+        std::error_code file_error;
+        const std::filesystem::path& path = file.path();
+        const auto time = file.last_write_time(file_error);
+        const uintmax_t size = file.file_size(file_error);
+        if(file_error) {
+          continue;
+        }
+
+        if(path.filename().string().find(TMP_MARKER) != std::string::npos) {
+          if(now - time > CACHE_STALE_TMP_AGE) {
+            std::filesystem::remove(path, file_error);
+          }
+          continue;
+        }
+
+        if(path.extension() != CACHE_EXTENSION) {
+          continue;
+        }
+
+        entries.push_back({path, time, size});
+        total += size;
+      }
+
+      if(total <= max_bytes) {
+        return;
+      }
+
+      std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time < b.time;
+      });
+
+      for(const Entry& entry : entries) {
+        if(total <= max_bytes) {
+          break;
+        }
+
+        std::filesystem::remove(entry.path, error);
+        total -= entry.size;
+      }
+    }
+
+  private:
+    // The cache directory
+    std::filesystem::path dir;
+
+    // Upper bound on the total size of the entries in dir
+    uintmax_t max_bytes;
+
+    const static uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    const static uint64_t FNV_PRIME = 1099511628211ULL;
+
+    // Marks the temporary files written by store
+    constexpr static const char* TMP_MARKER = ".tmp.";
+
+    // Cell kinds in the encoded table
+    enum CellKind : uint64_t { EMPTY_CELL, SHIFT_CELL, REDUCE_CELL, GOTO_CELL, ACCEPT_CELL, OTHER_CELL };
+
+    // 64 bit FNV-1a hash of str continuing from hash
+    static uint64_t fnv1a(uint64_t hash, const std::string& str) {
+      for(const char& c : str) {
+        hash ^= (unsigned char)c;
+        hash *= FNV_PRIME;
+      }
+
+      return hash;
+    }
+
+    std::filesystem::path get_entry_path(const std::string& key) const {
+      return dir / (get_key_id(key) + CACHE_EXTENSION);
+    }
+
+    // A temporary path that no other writer, in this process or
+    // another, will pick at the same time
+    std::filesystem::path get_tmp_path(const std::string& key) const {
+      static std::atomic<uint64_t> counter(0);
+
+      std::stringstream name;
+      name << get_key_id(key) << CACHE_EXTENSION << TMP_MARKER << getpid() << "."
+           << std::hash<std::thread::id>{}(std::this_thread::get_id()) << "." << counter++;
+
+      return dir / name.str();
+    }
+
+    /**
+     * Entry layout, with every integer written as an unsigned LEB128 varint
+     *
+     * magic, version
+     * key:        length and bytes of the key
+     * strings:    count, then length and bytes of each string
+     * cols:       count, then the string index of each column
+     * table:      rows, then row_size cells per row as (value << 3 | kind)
+     * item_sets:  count, then per set its size and the
+     *             production_num, position and lookahead string index of each item
+     * gotos:      count, then (from, symbol string index, to) for each mapping
+     * conflicts:  count, then (type, state, and the string indices of
+     *             symbol, chosen and dropped) for each conflict
+     * checksum:   FNV-1a of everything before it
+     */
+    static std::string encode(const std::string& key, const CachedGeneration& generation) {
+      std::vector<std::string> strings;
+      std::unordered_map<std::string, uint64_t> string_indices;
+      auto intern = [&](const std::string& str) {
+        auto result = string_indices.emplace(str, strings.size());
+        if(result.second) {
+          strings.push_back(str);
+        }
+        return result.first->second;
+      };
+
+      std::string body;
+      put_varint(body, generation.cols.size());
+      for(const std::string& col : generation.cols) {
+        put_varint(body, intern(col));
+      }
+
+      put_varint(body, generation.table.size());
+      for(const auto& row : generation.table) {
+        put_varint(body, row.size());
+        for(const std::string& action : row) {
+          uint64_t kind = EMPTY_CELL;
+          uint64_t value = 0;
+          if(action.empty()) {
+            kind = EMPTY_CELL;
+          }
+          else if(action == ACCEPT_ACTION) {
+            kind = ACCEPT_CELL;
+          }
+          else if(is_number(action, SHIFT_ACTION.size()) && action.compare(0, SHIFT_ACTION.size(), SHIFT_ACTION) == 0) {
+            kind = SHIFT_CELL;
+            value = std::stoull(action.substr(SHIFT_ACTION.size()));
+          }
+          else if(is_number(action, REDUCE_ACTION.size()) && action.compare(0, REDUCE_ACTION.size(), REDUCE_ACTION) == 0) {
+            kind = REDUCE_CELL;
+            value = std::stoull(action.substr(REDUCE_ACTION.size()));
+          }
+          else if(is_number(action, 0)) {
+            kind = GOTO_CELL;
+            value = std::stoull(action);
+          }
+          else {
+            kind = OTHER_CELL;
+            value = intern(action);
+          }
+          put_varint(body, value << 3 | kind);
+        }
+      }
+
+      put_varint(body, generation.item_sets.size());
+      for(const auto& items : generation.item_sets) {
+        put_varint(body, items.size());
+        for(const CachedItem& item : items) {
+          put_varint(body, item.production_num);
+          put_varint(body, item.position);
+          put_varint(body, intern(item.lookahead));
+        }
+      }
+
+      // Sort the gotos so equal generations encode to equal bytes
+      std::vector<std::pair<std::string, int>> gotos(generation.goto_indices.begin(), generation.goto_indices.end());
+      std::sort(gotos.begin(), gotos.end());
+
+      put_varint(body, gotos.size());
+      for(const auto& entry : gotos) {
+        const size_t comma = entry.first.find(',');
+        put_varint(body, std::stoull(entry.first.substr(0, comma)));
+        put_varint(body, intern(entry.first.substr(comma + 1)));
+        put_varint(body, entry.second);
+      }
+
+      put_varint(body, generation.conflicts.size());
+      for(const Conflict& conflict : generation.conflicts) {
+        put_varint(body, static_cast<uint64_t>(conflict.type));
+        put_varint(body, conflict.state);
+        put_varint(body, intern(conflict.symbol));
+        put_varint(body, intern(conflict.chosen));
+        put_varint(body, intern(conflict.dropped));
+      }
+
+      std::string data = CACHE_MAGIC;
+      put_varint(data, CACHE_FORMAT_VERSION);
+      put_varint(data, key.size());
+      data += key;
+      put_varint(data, strings.size());
+      for(const std::string& str : strings) {
+        put_varint(data, str.size());
+        data += str;
+      }
+      data += body;
+
+      put_varint(data, fnv1a(FNV_OFFSET_BASIS, data));
+      return data;
+    }
+
+    // Decodes an entry written by encode
+    // Returns false if data is truncated, corrupt, from another version
+    // or for a key other than key
+    static bool decode(const std::string& data, const std::string& key, CachedGeneration& generation) {
+      if(data.compare(0, CACHE_MAGIC.size(), CACHE_MAGIC) != 0) {
+        return false;
+      }
+
+      size_t pos = CACHE_MAGIC.size();
+      uint64_t value = 0;
+      bool ok = true;
+      auto next = [&]() {
+        ok = ok && get_varint(data, pos, value);
+        return ok ? value : 0;
+      };
+
+      // Every element takes at least one byte, so a count larger than
+      // what is left is corrupt and must not be allocated for
+      auto next_count = [&]() {
+        uint64_t count = next();
+        ok = ok && count <= data.size() - pos;
+        return ok ? count : 0;
+      };
+
+      if(next() != CACHE_FORMAT_VERSION || !ok) {
+        return false;
+      }
+
+      const uint64_t key_length = next();
+      if(!ok || key_length != key.size() || data.compare(pos, key_length, key) != 0) {
+        return false;
+      }
+      pos += key_length;
+
+      std::vector<std::string> strings(next_count());
+      for(std::string& str : strings) {
+        uint64_t length = next();
+        if(!ok || length > data.size() - pos) {
+          return false;
+        }
+        str = data.substr(pos, length);
+        pos += length;
+      }
+      auto string_at = [&](uint64_t index) {
+        ok = ok && index < strings.size();
+        return ok ? strings[index] : std::string();
+      };
+
+      CachedGeneration result;
+      result.cols.resize(next_count());
+      for(std::string& col : result.cols) {
+        col = string_at(next());
+      }
+
+      result.table.resize(next_count());
+      for(auto& row : result.table) {
+        row.resize(next_count());
+        for(std::string& action : row) {
+          uint64_t cell = next();
+          uint64_t cell_value = cell >> 3;
+          switch(cell & 7) {
+            case EMPTY_CELL:
+              break;
+            case SHIFT_CELL:
+              action = SHIFT_ACTION + std::to_string(cell_value);
+              break;
+            case REDUCE_CELL:
+              action = REDUCE_ACTION + std::to_string(cell_value);
+              break;
+            case GOTO_CELL:
+              action = std::to_string(cell_value);
+              break;
+            case ACCEPT_CELL:
+              action = ACCEPT_ACTION;
+              break;
+            case OTHER_CELL:
+              action = string_at(cell_value);
+              break;
+            default:
+              ok = false;
+          }
+          if(!ok) {
+            return false;
+          }
+        }
+      }
+
+      result.item_sets.resize(next_count());
+      for(auto& items : result.item_sets) {
+        items.resize(next_count());
+        for(CachedItem& item : items) {
+          item.production_num = next();
+          item.position = next();
+          item.lookahead = string_at(next());
+        }
+        if(!ok) {
+          return false;
+        }
+      }
+
+      uint64_t goto_count = next_count();
+      for(uint64_t i = 0; ok && i < goto_count; ++i) {
+        uint64_t from = next();
+        std::string symbol = string_at(next());
+        uint64_t to = next();
+        result.goto_indices[std::to_string(from) + "," + symbol] = to;
+      }
+
+      result.conflicts.resize(next_count());
+      for(Conflict& conflict : result.conflicts) {
+        const uint64_t type = next();
+        ok = ok && type <= static_cast<uint64_t>(ConflictType::REDUCE_REDUCE);
+        conflict.type = static_cast<ConflictType>(type);
+        conflict.state = next();
+        conflict.symbol = string_at(next());
+        conflict.chosen = string_at(next());
+        conflict.dropped = string_at(next());
+      }
+
+      const size_t checksum_pos = pos;
+      if(!ok || next() != fnv1a(FNV_OFFSET_BASIS, data.substr(0, checksum_pos)) || !ok || pos != data.size()) {
+        return false;
+      }
+
+      generation = std::move(result);
+      return true;
+    }
+
+    // Returns true if str from start on is a non-empty string of digits
+    static bool is_number(const std::string& str, size_t start) {
+      if(start >= str.size()) {
+        return false;
+      }
+
+      return std::all_of(str.begin() + start, str.end(), [](char c) {
+        return std::isdigit((unsigned char)c);
+      });
+    }
+};
+
+#endif /* _GENERATION_CACHE_HPP_ */
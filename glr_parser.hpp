@@ -0,0 +1,929 @@
+#ifndef _GLR_PARSER_HPP_
+#define _GLR_PARSER_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "grammar.hpp"
+#include "lr_parser.hpp"
+#include "parse_table_generator.hpp"
+
+/**
+ * Hands out objects cut from blocks that are only freed all at once
+ *
+ * A parse makes many small nodes that all die together, so rather than
+ * allocating each one they come from blocks that double in size.
+ * Pointers stay valid until the pool is cleared or destroyed, and
+ * clear keeps the blocks to hand them out again.
+ */
+template<typename T>
+class NodePool {
+  public:
+    NodePool(size_t first_block_size = 64) : next_block_size(first_block_size) {}
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+    NodePool(NodePool&&) = default;
+    NodePool& operator=(NodePool&&) = default;
+
+    // Returns count value initialized objects next to each other
+    T* allocate(size_t count = 1) {
+      while(block < blocks.size() && used + count > blocks[block].size) {
+        ++block;
+        used = 0;
+      }
+
+      if(block == blocks.size()) {
+        const size_t size = std::max(next_block_size, count);
+        blocks.push_back({std::unique_ptr<T[]>(new T[size]), size});
+        next_block_size = size * 2;
+      }
+
+      T* objects = blocks[block].objects.get() + used;
+      std::fill(objects, objects + count, T());
+      used += count;
+      allocated += count;
+      return objects;
+    }
+
+    // Makes every object handed out so far invalid
+    void clear() {
+      block = 0;
+      used = 0;
+      allocated = 0;
+    }
+
+    // Returns the number of objects handed out since the last clear
+    size_t size() const {
+      return allocated;
+    }
+
+  private:
+    struct Block {
+      std::unique_ptr<T[]> objects;
+      size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t next_block_size;
+
+    // The block objects are cut from and how much of it is used
+    size_t block = 0;
+    size_t used = 0;
+
+    size_t allocated = 0;
+};
+
+struct ForestNode;
+
+// One way a ForestNode derives its tokens, with the nodes of the rhs symbols
+struct PackedNode {
+  int production = -1;
+  ForestNode** children = nullptr;
+  size_t child_count = 0;
+  PackedNode* next = nullptr;
+};
+
+/**
+ * A node of a shared packed parse forest (SPPF)
+ *
+ * Either a token or a non-terminal with the tokens [start, end) it
+ * derives. Each way it derives them is a PackedNode, so an ambiguous
+ * span is one node with several derivations, and a node is shared by
+ * every derivation it is part of.
+ */
+struct ForestNode {
+  // The grammar symbol of a non-terminal, or the table column of a token
+  int symbol = -1;
+  bool token = false;
+
+  size_t start = 0;
+  size_t end = 0;
+
+  // The derivations in the order the parser found them, null for a token
+  PackedNode* derivations = nullptr;
+
+  bool is_ambiguous() const {
+    return derivations && derivations->next;
+  }
+};
+
+template<typename Table>
+class GLRParser;
+
+/**
+ * Every derivation of a sentence, as found by GLRParser
+ *
+ * The forest owns its nodes, which live in pools as long as it does.
+ * The first derivation of every node was built from nodes that existed
+ * before it, so following first derivations always reaches the tokens.
+ * Only later derivations can form cycles, for a grammar where a
+ * non-terminal derives itself.
+ */
+class ParseForest {
+  public:
+    ParseForest() {}
+
+    ParseForest(ParseForest&&) = default;
+    ParseForest& operator=(ParseForest&&) = default;
+
+    // Returns the start symbol's node, covering every token
+    const ForestNode* get_root() const {
+      return root;
+    }
+
+    // Returns the number of token and non-terminal nodes
+    size_t get_node_count() const {
+      return nodes.size();
+    }
+
+    // Returns true if a node the root reaches has more than one derivation
+    bool is_ambiguous() const {
+      bool ambiguous = false;
+      for_each_node([&](const ForestNode* node) {
+        ambiguous = ambiguous || node->is_ambiguous();
+      });
+      return ambiguous;
+    }
+
+    /**
+     * Returns the number of parse trees in the forest
+     * Saturates at UINT64_MAX, which is also returned for a forest with
+     * a cycle, as it holds infinitely many trees
+     */
+    uint64_t count_trees() const {
+      const uint64_t max = std::numeric_limits<uint64_t>::max();
+      if(!root) {
+        return 0;
+      }
+
+      std::unordered_map<const ForestNode*, uint64_t> counts;
+      std::unordered_set<const ForestNode*> open;
+      std::vector<std::pair<const ForestNode*, bool>> stack = {{root, false}};
+      while(!stack.empty()) {
+        const ForestNode* node = stack.back().first;
+        const bool expanded = stack.back().second;
+        stack.pop_back();
+        if(node->token || counts.count(node) > 0) {
+          continue;
+        }
+
+        // Everything taken off the stack between expanding a node and
+        // counting it is below it, so meeting it again is a cycle
+        if(!expanded) {
+          if(!open.insert(node).second) {
+            return max;
+          }
+
+          stack.push_back({node, true});
+          for(const PackedNode* derivation = node->derivations; derivation; derivation = derivation->next) {
+            for(size_t i = 0; i < derivation->child_count; ++i) {
+              stack.push_back({derivation->children[i], false});
+            }
+          }
+          continue;
+        }
+
+        uint64_t total = 0;
+        for(const PackedNode* derivation = node->derivations; derivation; derivation = derivation->next) {
+          uint64_t product = 1;
+          for(size_t i = 0; i < derivation->child_count; ++i) {
+            const ForestNode* child = derivation->children[i];
+            const uint64_t count = child->token ? 1 : counts[child];
+            product = count != 0 && product > max / count ? max : product * count;
+          }
+          total = total > max - product ? max : total + product;
+        }
+
+        open.erase(node);
+        counts[node] = total;
+      }
+
+      return counts[root];
+    }
+
+    /**
+     * Returns the productions of one parse tree in the order LRParser
+     * would reduce by them, which is a rightmost derivation in reverse
+     *
+     * Takes the first derivation of each node, so where the grammar has
+     * no ambiguity this is what LRParser returns
+     */
+    std::vector<int> get_reductions() const {
+      std::vector<int> reductions;
+      if(!root) {
+        return reductions;
+      }
+
+      // Post order, each entry is a node and the next child to visit
+      std::vector<std::pair<const ForestNode*, size_t>> stack = {{root, 0}};
+      while(!stack.empty()) {
+        const ForestNode* node = stack.back().first;
+        const PackedNode* derivation = node->derivations;
+        const size_t child = stack.back().second++;
+
+        if(child < derivation->child_count) {
+          const ForestNode* next = derivation->children[child];
+          if(!next->token) {
+            stack.push_back({next, 0});
+          }
+          continue;
+        }
+
+        reductions.push_back(derivation->production);
+        stack.pop_back();
+      }
+
+      return reductions;
+    }
+
+  private:
+    template<typename Table>
+    friend class GLRParser;
+
+    NodePool<ForestNode> nodes;
+    NodePool<PackedNode> packed_nodes;
+    NodePool<ForestNode*> children;
+
+    ForestNode* root = nullptr;
+
+    // Calls on_node once with each non-terminal node the root reaches
+    template<typename F>
+    void for_each_node(F on_node) const {
+      if(!root) {
+        return;
+      }
+
+      std::unordered_set<const ForestNode*> seen = {root};
+      std::vector<const ForestNode*> stack = {root};
+      while(!stack.empty()) {
+        const ForestNode* node = stack.back();
+        stack.pop_back();
+        on_node(node);
+
+        for(const PackedNode* derivation = node->derivations; derivation; derivation = derivation->next) {
+          for(size_t i = 0; i < derivation->child_count; ++i) {
+            const ForestNode* child = derivation->children[i];
+            if(!child->token && seen.insert(child).second) {
+              stack.push_back(child);
+            }
+          }
+        }
+      }
+    }
+};
+
+/**
+ * Runs the generalized LR parsing algorithm over a table whose entries
+ * may hold several actions, as built with
+ * LR1ParserTableGenerator::set_keep_conflicts
+ *
+ * Where an entry holds more than one action the parser takes all of
+ * them, following every stack that could still lead to a parse. The
+ * stacks share their common parts in a graph-structured stack (GSS),
+ * with a node per state and position, and the trees share their common
+ * parts in a ParseForest. Algorithm from Tomita, with the correction of
+ * Nozohoor-Farshi so reductions by empty productions find every path:
+ *
+ * For each token a, starting from the start state's node
+ * 1. Take the actions of every node v on a. A reduce by A → β follows
+ *     every path of |β| edges down from v to a node w, and pushes
+ *     GOTO[w, A] on top of w, reusing the node of that state for this
+ *     position if there is one
+ * 2. If a new edge is added to a node that exists already, the
+ *     reductions of the nodes that have taken their actions are done
+ *     again along the paths through the new edge
+ * 3. Once no reduction is left, every shift on a pushes its state on
+ *     top of its node, and these nodes are the stacks for the next token
+ * 4. The parse is accepted on $ if a node accepts, and is an error
+ *     if no stack is left to shift
+ *
+ * Where every entry the parse reads holds one action, there is one stack
+ * top and a reduce has one path down. That is the LR fast path: actions
+ * are read without splitting the entry, a reduce walks the edges
+ * straight down and nodes are looked up by state in an array, so apart
+ * from building the forest a deterministic stretch costs what LRParser
+ * does. Only ambiguous spans search the GSS.
+ *
+ * GSS and forest nodes come from NodePools, the GSS ones are dropped
+ * together when the parse finishes.
+ *
+ * Like LRParser, the parser keeps no state between calls to parse.
+ */
+template<typename Table>
+class GLRParser {
+  public:
+    GLRParser(const Grammar& grammar, const Table& table) : table(table), symbol_count(grammar.symbol_count()) {
+      for(size_t i = 0; i < grammar.size(); ++i) {
+        const Production& production = grammar.get_production(i);
+        lhs_symbols.push_back(production.lhs);
+        lhs_cols.push_back(table.get_column(grammar.get_symbol(production.lhs)));
+        rhs_sizes.push_back(production.rhs.size());
+      }
+
+      dollar_col = table.get_column(DOLLAR);
+    }
+
+    /**
+     * Parses tokens, a sentence of terminals like 'ID' '=' 'ID'
+     * The end of the input is added and need not be in tokens
+     *
+     * start_state picks the start symbol for a grammar with several,
+     * see LR1ParserTableGenerator::get_start_state
+     *
+     * Returns every parse tree of tokens in a forest
+     * Throws ParseError at the first token no stack has an action for
+     */
+    ParseForest parse(const std::vector<std::string>& tokens, int start_state = 0) const {
+      std::vector<int> token_cols;
+      token_cols.reserve(tokens.size() + 1);
+      for(size_t position = 0; position < tokens.size(); ++position) {
+        const int col = table.get_column(tokens[position]);
+        if(col < 0 || col == dollar_col) {
+          throw ParseError(position, tokens[position]);
+        }
+        token_cols.push_back(col);
+      }
+      token_cols.push_back(dollar_col);
+
+      return parse(token_cols, start_state);
+    }
+
+    /**
+     * Parses tokens given as the table columns of their terminals,
+     * like the token ids from a Scanner
+     * tokens must end with the column of $
+     *
+     * Returns and throws as above
+     */
+    ParseForest parse(const std::vector<int>& tokens, int start_state = 0) const {
+      ParseForest forest;
+      Run run(*this, tokens, forest);
+      forest.root = run.parse(start_state);
+      return forest;
+    }
+
+    // Returns true if tokens is a sentence of the grammar
+    bool accepts(const std::vector<std::string>& tokens, int start_state = 0) const {
+      try {
+        parse(tokens, start_state);
+        return true;
+      }
+      catch(const ParseError& e) {
+        return false;
+      }
+    }
+
+  private:
+    struct StackEdge;
+
+    // A GSS node, the state pushed after reading the tokens before position
+    struct StackNode {
+      int state = 0;
+      size_t position = 0;
+
+      // Towards the bottom of the stacks
+      StackEdge* edges = nullptr;
+
+      // True once the node took its actions on the token at position
+      bool processed = false;
+
+      // 1 if there is one path down to the start node, 0 if there are
+      // more, -1 if not known yet. Only known once position is finished
+      int linear = -1;
+
+      // The node's place on the LR stack, if it has been on it
+      size_t stack_index = std::numeric_limits<size_t>::max();
+    };
+
+    struct StackEdge {
+      StackNode* to = nullptr;
+
+      // The symbol read between the two states
+      ForestNode* label = nullptr;
+
+      StackEdge* next = nullptr;
+    };
+
+    // An entry of the LR stack the parser uses while there is one stack,
+    // the same as a StackNode with one edge down
+    struct StackEntry {
+      int state;
+      ForestNode* label;
+      size_t position;
+
+      // The entry's node if it has been in the GSS, else null
+      StackNode* node;
+    };
+
+    // A reduce still to be done from node, on the paths through edge
+    struct PendingReduction {
+      StackNode* node;
+      int production;
+      StackEdge* through;
+    };
+
+    // The work of one call to parse
+    class Run {
+      public:
+        Run(const GLRParser& parser, const std::vector<int>& tokens, ParseForest& forest) :
+          parser(parser),
+          tokens(tokens),
+          forest(forest),
+          symbol_nodes(parser.symbol_count),
+          symbol_positions(parser.symbol_count, std::numeric_limits<size_t>::max()) {}
+
+        /**
+         * Returns the root of the forest
+         *
+         * Parses on the LR stack until an entry holds several actions,
+         * then moves the stack into the GSS. Once the GSS is down to one
+         * stack again it goes back onto the LR stack.
+         */
+        ForestNode* parse(int start_state) {
+          start = stack_nodes.allocate();
+          start->state = start_state;
+          start->linear = 1;
+          stack.push_back({start_state, nullptr, 0, start});
+          start->stack_index = 0;
+
+          while(position < tokens.size()) {
+            col = tokens[position];
+            if(col < 0 || col > parser.dollar_col) {
+              throw ParseError(position, std::to_string(col));
+            }
+
+            if(on_stack) {
+              const std::string& action = get_action(stack.back().state, col);
+              if(!is_conflict_action(action)) {
+                if(is_shift_action(action)) {
+                  stack.push_back({get_action_number(action), make_token_node(), position + 1, nullptr});
+                  ++position;
+                }
+                else if(is_reduce_action(action)) {
+                  reduce_stack(get_action_number(action));
+                }
+                else if(action == ACCEPT_ACTION) {
+                  return stack.back().label;
+                }
+                else {
+                  throw ParseError(position, parser.table.get_columns()[col]);
+                }
+                continue;
+              }
+
+              move_to_gss();
+            }
+
+            take_actions();
+
+            if(accepting) {
+              for(StackEdge* edge = accepting->edges; edge; edge = edge->next) {
+                if(edge->to == start) {
+                  return edge->label;
+                }
+              }
+              throw std::runtime_error("accepting state " + std::to_string(accepting->state) + " is not above the start state");
+            }
+
+            if(shifts.empty()) {
+              throw ParseError(position, parser.table.get_columns()[col]);
+            }
+            shift();
+
+            if(frontier.size() == 1 && is_linear(frontier[0])) {
+              move_to_stack(frontier[0]);
+            }
+          }
+
+          throw ParseError(position, DOLLAR);
+        }
+
+      private:
+        const GLRParser& parser;
+        const std::vector<int>& tokens;
+        ParseForest& forest;
+
+        NodePool<StackNode> stack_nodes;
+        NodePool<StackEdge> stack_edges;
+
+        // The token being read and its column
+        size_t position = 0;
+        int col = 0;
+
+        StackNode* start = nullptr;
+
+        // The LR stack, only in use while on_stack is set. Otherwise it
+        // is kept as it was, so the entries that are still the bottom
+        // of the one stack when the parser goes back to it are reused
+        std::vector<StackEntry> stack;
+        bool on_stack = true;
+
+        // The nodes for position in the order they were pushed
+        std::vector<StackNode*> frontier;
+
+        // The last node pushed for each state, which is in the frontier
+        // if its position is the current one
+        std::vector<StackNode*> state_nodes;
+
+        // Nodes yet to take their actions
+        std::vector<StackNode*> unprocessed;
+
+        // Reductions again through a new edge, see step 2
+        std::vector<PendingReduction> reductions;
+
+        // The nodes that shift and the states they shift to
+        std::vector<std::pair<StackNode*, int>> shifts;
+
+        StackNode* accepting = nullptr;
+
+        // The forest nodes of each symbol that end at symbol_positions[symbol]
+        std::vector<std::vector<ForestNode*>> symbol_nodes;
+        std::vector<size_t> symbol_positions;
+
+        // The edge labels of the path a reduce is following
+        std::vector<ForestNode*> labels;
+
+        // Scratch space for walking down the GSS
+        std::vector<StackNode*> path;
+
+        // Reduces by production on the LR stack
+        void reduce_stack(int production) {
+          const size_t length = parser.rhs_sizes[production];
+          const StackEntry& bottom = stack[stack.size() - length - 1];
+
+          const std::string& goto_action = get_action(bottom.state, parser.lhs_cols[production]);
+          if(!is_goto_action(goto_action)) {
+            throw std::runtime_error("no goto for production " + std::to_string(production) + " in state " + std::to_string(bottom.state));
+          }
+
+          if(labels.size() < length) {
+            labels.resize(length);
+          }
+          for(size_t i = 0; i < length; ++i) {
+            labels[i] = stack[stack.size() - length + i].label;
+          }
+
+          ForestNode* symbol = get_symbol_node(parser.lhs_symbols[production], bottom.position);
+          add_derivation(symbol, production, length);
+
+          stack.resize(stack.size() - length);
+          stack.push_back({get_action_number(goto_action), symbol, position, nullptr});
+        }
+
+        /**
+         * Gives the entries of the LR stack that have no node yet one,
+         * and makes those for position the frontier, with the top one
+         * left to take its actions
+         */
+        void move_to_gss() {
+          size_t first = stack.size();
+          while(!stack[first - 1].node) {
+            --first;
+          }
+
+          for(size_t i = first; i < stack.size(); ++i) {
+            StackNode* node = stack_nodes.allocate();
+            node->state = stack[i].state;
+            node->position = stack[i].position;
+            node->stack_index = i;
+            if(node->position < position) {
+              node->linear = 1;
+            }
+            add_edge(node, stack[i - 1].node, stack[i].label);
+            stack[i].node = node;
+          }
+
+          frontier.clear();
+          for(size_t i = stack.size(); i > 0 && stack[i - 1].position == position; --i) {
+            StackNode* node = stack[i - 1].node;
+            node->processed = i < stack.size();
+            add_to_frontier(node);
+          }
+          unprocessed.push_back(stack.back().node);
+
+          on_stack = false;
+        }
+
+        /**
+         * Puts the one path down from top back on the LR stack
+         * The walk stops at the first node still on the stack as it was
+         */
+        void move_to_stack(StackNode* top) {
+          path.clear();
+          StackNode* node = top;
+          while(node->stack_index >= stack.size() || stack[node->stack_index].node != node) {
+            path.push_back(node);
+            node = node->edges->to;
+          }
+
+          stack.resize(node->stack_index + 1);
+          for(auto it = path.rbegin(); it != path.rend(); ++it) {
+            (*it)->stack_index = stack.size();
+            stack.push_back({(*it)->state, (*it)->edges->label, (*it)->position, *it});
+          }
+
+          frontier.clear();
+          unprocessed.clear();
+          on_stack = true;
+        }
+
+        // Returns true if there is one path down from top to the start node
+        bool is_linear(StackNode* top) {
+          // top's position is not finished, so it is the only node on the
+          // walk whose edges may still change and it is never marked
+          path.clear();
+          StackNode* node = top;
+          while(node->linear < 0 && node->edges && !node->edges->next) {
+            path.push_back(node);
+            node = node->edges->to;
+          }
+
+          const int linear = std::max(node->linear, 0);
+          if(node != top) {
+            node->linear = linear;
+          }
+          for(StackNode* below : path) {
+            if(below != top) {
+              below->linear = linear;
+            }
+          }
+
+          return linear == 1;
+        }
+
+        // Steps 1 and 2 for the token at position
+        void take_actions() {
+          while(!unprocessed.empty() || !reductions.empty()) {
+            if(!reductions.empty()) {
+              const PendingReduction reduction = reductions.back();
+              reductions.pop_back();
+              reduce(reduction.node, reduction.production, reduction.through);
+              continue;
+            }
+
+            StackNode* node = unprocessed.back();
+            unprocessed.pop_back();
+            node->processed = true;
+
+            const std::string& entry = get_action(node->state, col);
+            if(!is_conflict_action(entry)) {
+              take_action(node, entry);
+              continue;
+            }
+
+            for(const std::string& action : get_entry_actions(entry)) {
+              take_action(node, action);
+            }
+          }
+        }
+
+        void take_action(StackNode* node, const std::string& action) {
+          if(is_shift_action(action)) {
+            shifts.push_back({node, get_action_number(action)});
+          }
+          else if(is_reduce_action(action)) {
+            reduce(node, get_action_number(action), nullptr);
+          }
+          else if(action == ACCEPT_ACTION) {
+            accepting = node;
+          }
+        }
+
+        // Reduces by production along every path down from node,
+        // or only those through the edge through if it is set
+        void reduce(StackNode* node, int production, StackEdge* through) {
+          const size_t length = parser.rhs_sizes[production];
+          if(labels.size() < length) {
+            labels.resize(length);
+          }
+
+          if(length == 0) {
+            if(!through) {
+              reduce_path(node, production, 0);
+            }
+            return;
+          }
+
+          // The fast path, a stack with one path down
+          if(!through) {
+            StackNode* bottom = node;
+            size_t remaining = length;
+            while(remaining > 0 && bottom->edges && !bottom->edges->next) {
+              labels[--remaining] = bottom->edges->label;
+              bottom = bottom->edges->to;
+            }
+
+            if(remaining == 0) {
+              reduce_path(bottom, production, length);
+              return;
+            }
+          }
+
+          reduce_paths(node, production, length, length, through, false);
+        }
+
+        // Follows every path of remaining edges down from node,
+        // filling labels from the end
+        void reduce_paths(StackNode* node, int production, size_t length, size_t remaining, StackEdge* through, bool through_seen) {
+          if(remaining == 0) {
+            if(!through || through_seen) {
+              reduce_path(node, production, length);
+            }
+            return;
+          }
+
+          for(StackEdge* edge = node->edges; edge; edge = edge->next) {
+            labels[remaining - 1] = edge->label;
+            reduce_paths(edge->to, production, length, remaining - 1, through, through_seen || edge == through);
+          }
+        }
+
+        // Pushes GOTO[bottom, A] on top of bottom for production A → β,
+        // where labels holds the |β| symbols popped
+        void reduce_path(StackNode* bottom, int production, size_t length) {
+          const std::string& goto_action = get_action(bottom->state, parser.lhs_cols[production]);
+          if(!is_goto_action(goto_action)) {
+            throw std::runtime_error("no goto for production " + std::to_string(production) + " in state " + std::to_string(bottom->state));
+          }
+          const int state = get_action_number(goto_action);
+
+          ForestNode* symbol = get_symbol_node(parser.lhs_symbols[production], bottom->position);
+          add_derivation(symbol, production, length);
+
+          StackNode* top = get_node(state);
+          if(!top) {
+            add_edge(push_node(state), bottom, symbol);
+            return;
+          }
+
+          // A state is only reached on one symbol, so an edge between
+          // the same nodes already has this label
+          for(StackEdge* edge = top->edges; edge; edge = edge->next) {
+            if(edge->to == bottom) {
+              return;
+            }
+          }
+
+          StackEdge* edge = add_edge(top, bottom, symbol);
+          for(StackNode* node : frontier) {
+            if(!node->processed) {
+              continue;
+            }
+
+            for_each_reduce(node, [&](int reduce_production) {
+              if(parser.rhs_sizes[reduce_production] > 0) {
+                reductions.push_back({node, reduce_production, edge});
+              }
+            });
+          }
+        }
+
+        // Calls on_reduce with the production of each reduce node takes
+        template<typename F>
+        void for_each_reduce(StackNode* node, F on_reduce) {
+          const std::string& entry = get_action(node->state, col);
+          if(!is_conflict_action(entry)) {
+            if(is_reduce_action(entry)) {
+              on_reduce(get_action_number(entry));
+            }
+            return;
+          }
+
+          for(const std::string& action : get_entry_actions(entry)) {
+            if(is_reduce_action(action)) {
+              on_reduce(get_action_number(action));
+            }
+          }
+        }
+
+        // Step 3, which moves on to the next token
+        void shift() {
+          ForestNode* token = make_token_node();
+
+          ++position;
+          frontier.clear();
+          for(const auto& shift : shifts) {
+            StackNode* top = get_node(shift.second);
+            add_edge(top ? top : push_node(shift.second), shift.first, token);
+          }
+          shifts.clear();
+        }
+
+        // Returns a forest node for the token at position
+        ForestNode* make_token_node() {
+          ForestNode* token = forest.nodes.allocate();
+          token->symbol = col;
+          token->token = true;
+          token->start = position;
+          token->end = position + 1;
+          return token;
+        }
+
+        const std::string& get_action(int state, int action_col) const {
+          return parser.table.get_row(state)[action_col];
+        }
+
+        // Returns the node of state for position, or null
+        StackNode* get_node(int state) const {
+          if(state >= state_nodes.size() || !state_nodes[state] || state_nodes[state]->position != position) {
+            return nullptr;
+          }
+          return state_nodes[state];
+        }
+
+        // Pushes a node of state for position, which takes its actions next
+        StackNode* push_node(int state) {
+          StackNode* node = stack_nodes.allocate();
+          node->state = state;
+          node->position = position;
+
+          add_to_frontier(node);
+          unprocessed.push_back(node);
+          return node;
+        }
+
+        void add_to_frontier(StackNode* node) {
+          if(node->state >= state_nodes.size()) {
+            state_nodes.resize(node->state + 1, nullptr);
+          }
+          state_nodes[node->state] = node;
+          frontier.push_back(node);
+        }
+
+        StackEdge* add_edge(StackNode* top, StackNode* bottom, ForestNode* label) {
+          StackEdge* edge = stack_edges.allocate();
+          edge->to = bottom;
+          edge->label = label;
+          edge->next = top->edges;
+          top->edges = edge;
+          return edge;
+        }
+
+        // Returns the forest node of symbol over [start, position),
+        // adding it if it is new
+        ForestNode* get_symbol_node(int symbol, size_t start) {
+          std::vector<ForestNode*>& nodes = symbol_nodes[symbol];
+          if(symbol_positions[symbol] != position) {
+            symbol_positions[symbol] = position;
+            nodes.clear();
+          }
+
+          for(ForestNode* node : nodes) {
+            if(node->start == start) {
+              return node;
+            }
+          }
+
+          ForestNode* node = forest.nodes.allocate();
+          node->symbol = symbol;
+          node->start = start;
+          node->end = position;
+          nodes.push_back(node);
+          return node;
+        }
+
+        // Adds production with the first length labels as children
+        // to the derivations of node, unless it has it already
+        void add_derivation(ForestNode* node, int production, size_t length) {
+          PackedNode** tail = &node->derivations;
+          for(; *tail; tail = &(*tail)->next) {
+            if((*tail)->production == production && std::equal(labels.begin(), labels.begin() + length, (*tail)->children)) {
+              return;
+            }
+          }
+
+          PackedNode* derivation = forest.packed_nodes.allocate();
+          derivation->production = production;
+          derivation->child_count = length;
+          if(length > 0) {
+            derivation->children = forest.children.allocate(length);
+            std::copy(labels.begin(), labels.begin() + length, derivation->children);
+          }
+          *tail = derivation;
+        }
+    };
+
+    const Table& table;
+    size_t symbol_count;
+
+    std::vector<int> lhs_symbols;
+
+    // The goto column of the lhs of each production
+    std::vector<int> lhs_cols;
+
+    // The number of symbols to pop when reducing by each production
+    std::vector<size_t> rhs_sizes;
+
+    int dollar_col;
+};
+
+#endif /* _GLR_PARSER_HPP_ */
@@ -1,10 +1,16 @@
 #ifndef _GRAMMAR_HPP_
 #define _GRAMMAR_HPP_
 
-#include <regex>
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <set>
 #include <string>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 // special symbol for grammar rule serparator
 const static std::string RULE_SEP = "->";
@@ -19,11 +25,53 @@ const static std::string DOLLAR = "$";
 // i.e. the S' in S' -> S
 const static std::string AUGMENTED_LHS = "S'";
 
+// Returns true if symbol is S' or the augmented symbol of another
+// start symbol like S'statement
+bool is_augmented_symbol(const std::string& symbol) {
+  return symbol.compare(0, AUGMENTED_LHS.size(), AUGMENTED_LHS) == 0;
+}
+
+// Precedence declarations, as in yacc
+// Each declaration binds tighter than the ones before it
+// %left '+' '-'
+// %left '*' '/'
+const static std::string LEFT_DECLARATION = "%left";
+const static std::string RIGHT_DECLARATION = "%right";
+const static std::string NONASSOC_DECLARATION = "%nonassoc";
+
+// Gives a production the precedence of a terminal instead of
+// the precedence of its last terminal
+// E -> '-' E %prec 'UMINUS'
+const static std::string PREC_MARKER = "%prec";
+
+// Separates alternatives for the same lhs, or inside an EBNF group
+const static std::string ALTERNATIVE_SEP = "|";
+
+// EBNF grouping and repetition in a production's rhs
+// args -> expression ( ',' expression )*
+const static std::string GROUP_OPEN = "(";
+const static std::string GROUP_CLOSE = ")";
+const static std::string EBNF_OPERATORS = "*+?";
+
+// The most productions one EBNF production is expanded into before
+// the rest of its optional parts are moved to a helper non-terminal
+const static size_t MAX_EBNF_EXPANSIONS = 16;
+
 // Determines if symbol is a terminal
+// Terminals are quoted and contain no whitespace, i.e. match '[^[:space:]]+'
 // TODO : Find a better spot for this
-bool is_terminal(const std::string symbol) {
-  // return !std::regex_match(symbol, std::regex("[A-Z]"));
-  return std::regex_match(symbol, std::regex("'[^[:space:]]+'"));
+bool is_terminal(const std::string& symbol) {
+  if(symbol.size() < 3 || symbol.front() != '\'' || symbol.back() != '\'') {
+    return false;
+  }
+
+  for(const char& c : symbol) {
+    if(std::isspace((unsigned char)c)) {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 // Remove space characters in string
@@ -63,74 +111,478 @@ std::string get_LHS(const std::string production) {
   return "";
 }
 
+/**
+ * A production with its symbols interned by a Grammar
+ * 
+ * Given A -> B 'c', lhs is the id of A and rhs the ids of B and 'c'
+ * The rhs of an empty production A -> ~ is empty
+ */
+struct Production {
+  int lhs;
+  std::vector<int> rhs;
+
+  // The terminal named by %prec, or -1
+  int precedence_symbol = -1;
+};
+
+// How operators of the same precedence level group
+enum class Associativity {
+  NONE,
+  LEFT,
+  RIGHT,
+  NONASSOC
+};
+
+/**
+ * The precedence of a terminal or production
+ * Higher levels bind tighter. Level 0 means no precedence was declared
+ */
+struct Precedence {
+  int level = 0;
+  Associativity associativity = Associativity::NONE;
+
+  bool empty() const {
+    return level == 0;
+  }
+};
+
+// Returns the declaration keyword for associativity, or "" for NONE
+const std::string& get_associativity_declaration(Associativity associativity) {
+  const static std::string none;
+
+  switch(associativity) {
+    case Associativity::LEFT: return LEFT_DECLARATION;
+    case Associativity::RIGHT: return RIGHT_DECLARATION;
+    case Associativity::NONASSOC: return NONASSOC_DECLARATION;
+    default: return none;
+  }
+}
+
+// Returns the associativity of a declaration keyword like %left,
+// or NONE if declaration isn't one
+Associativity get_declaration_associativity(const std::string& declaration) {
+  if(declaration == LEFT_DECLARATION) {
+    return Associativity::LEFT;
+  }
+  if(declaration == RIGHT_DECLARATION) {
+    return Associativity::RIGHT;
+  }
+  if(declaration == NONASSOC_DECLARATION) {
+    return Associativity::NONASSOC;
+  }
+
+  return Associativity::NONE;
+}
+
+/**
+ * What Grammar::remove_useless_productions took out of a grammar
+ */
+struct GrammarReduction {
+  // The removed productions in their original order
+  std::vector<std::string> removed_productions;
+
+  // Non-terminals that derive no string of terminals
+  std::set<std::string> unproductive_symbols;
+
+  // Symbols the start symbol never reaches
+  std::set<std::string> unreachable_symbols;
+
+  bool empty() const {
+    return removed_productions.empty();
+  }
+};
+
 /**
  *  A class to store and extract grammar information
  * 
  * Takes a vector of strings like S -> Ab, representing
  * the production rules of the grammar
  * 
+ * Productions can also be added one at a time from interned
+ * symbol ids with intern_symbol and add_production. The text of
+ * such productions is only built if it is asked for.
+ *
+ * A string may also be a precedence declaration like %left '+' '-',
+ * and a production may end with %prec and a terminal. See
+ * declare_precedence and get_production_precedence.
+ *
+ * A production may use EBNF groups and the operators *, + and ?,
+ * which are expanded into plain productions. See add_ebnf_production.
+ * 
  * Wraps std::vector<std::string>
  */
 class Grammar {
   public:
-    Grammar(const std::vector<std::string>& g) : productions(g) {
+    Grammar() {}
+
+    Grammar(const std::vector<std::string>& g) {
       // Extract the terminals and non-terminals from g
       for(const auto& production : g) {
+        std::vector<std::string> symbols = Grammar::extract_symbols(production);
+        Associativity associativity = symbols.empty() ? Associativity::NONE : get_declaration_associativity(symbols[0]);
+        if(associativity != Associativity::NONE) {
+          declare_precedence(associativity, std::vector<std::string>(symbols.begin() + 1, symbols.end()));
+          continue;
+        }
+
         // LHS should be a single non-terminal
-        std::string lhs = get_LHS(production);
-        non_terminals.insert(lhs);
-        all_symbols.insert(lhs);
+        int lhs = intern_symbol(get_LHS(production));
 
         // Get rhs symbols and store them
         std::vector<std::string> rhs_symbols = Grammar::extract_symbols(get_RHS(production));
-        for(const auto& rh_symbol : rhs_symbols) {
+        if(std::any_of(rhs_symbols.begin(), rhs_symbols.end(), Grammar::is_ebnf_symbol)) {
+          add_ebnf_production(lhs, rhs_symbols);
+          continue;
+        }
+
+        std::vector<int> rhs;
+        int precedence_symbol = -1;
+        for(int i = 0; i < rhs_symbols.size(); ++i) {
+          const std::string& rh_symbol = rhs_symbols[i];
+
           // Skip empty set symbol since it is just a placeholder
           if(rh_symbol == EPSILON) {
             continue;
           }
-          is_terminal(rh_symbol) ? terminals.insert(rh_symbol) : non_terminals.insert(rh_symbol);
-          all_symbols.insert(rh_symbol);
+
+          if(rh_symbol == PREC_MARKER) {
+            if(i != rhs_symbols.size() - 2 || !is_terminal(rhs_symbols[i+1])) {
+              throw std::runtime_error(PREC_MARKER + " must be followed by a terminal at the end of " + production);
+            }
+            precedence_symbol = intern_symbol(rhs_symbols[i+1]);
+            break;
+          }
+
+          rhs.push_back(intern_symbol(rh_symbol));
+        }
+
+        // The text of the production leaves out the %prec so items
+        // only see the rhs symbols
+        if(precedence_symbol >= 0) {
+          productions.push_back(production.substr(0, production.rfind(PREC_MARKER)));
+          while(productions.back().back() == ' ') {
+            productions.back().pop_back();
+          }
         }
+        else {
+          productions.push_back(production);
+        }
+
+        add_interned_production(lhs, std::move(rhs));
+        interned_productions.back().precedence_symbol = precedence_symbol;
       }
     };
 
     // Return the const iterator to the underlying productions
     std::vector<std::string>::const_iterator begin() {
+      build_production_strings();
       return productions.cbegin();
     }
 
     // Return the const iterator to the underlying productions
     std::vector<std::string>::const_iterator end() {
+      build_production_strings();
       return productions.cend();
     }
 
-    const std::set<std::string>& get_all_symbols() {
+    const std::set<std::string>& get_all_symbols() const {
       return all_symbols;
     }
 
-    const std::set<std::string>& get_terminals() {
+    const std::set<std::string>& get_terminals() const {
       return terminals;
     }
 
-    const std::set<std::string>& get_non_terminals() {
+    const std::set<std::string>& get_non_terminals() const {
       return non_terminals;
     }
 
     const std::string& at(const size_t n) const {
+      build_production_strings();
       return productions[n];
     }
 
     // allow bracket access to productions
-    const std::string& operator[](size_t n) {
+    const std::string& operator[](size_t n) const {
+      build_production_strings();
       return productions[n];
     }
 
-    size_t size() {
-      return productions.size();
+    size_t size() const {
+      return interned_productions.size();
+    }
+
+    bool empty() const {
+      return interned_productions.empty();
+    }
+
+    /**
+     * Returns the id of symbol, giving it the next id if
+     * it has not been seen before
+     * 
+     * Symbols are classified as terminals or non-terminals by name
+     * when they are first used in a production
+     */
+    int intern_symbol(const std::string& symbol) {
+      const auto found = symbol_ids.find(symbol);
+      if(found != symbol_ids.end()) {
+        return found->second;
+      }
+
+      int id = symbol_names.size();
+      symbol_names.push_back(symbol);
+      symbol_ids.emplace(symbol, id);
+      return id;
+    }
+
+    // Returns the id of symbol or -1 if it is not part of this grammar
+    int get_symbol_id(const std::string& symbol) const {
+      const auto found = symbol_ids.find(symbol);
+      return found != symbol_ids.end() ? found->second : -1;
+    }
+
+    // Returns the name of the symbol with the given id
+    const std::string& get_symbol(int id) const {
+      return symbol_names[id];
+    }
+
+    // Returns the number of interned symbols
+    size_t symbol_count() const {
+      return symbol_names.size();
+    }
+
+    /**
+     * Appends the production lhs -> rhs from interned symbol ids
+     * An empty rhs is the production lhs -> ~
+     */
+    void add_production(int lhs, std::vector<int> rhs) {
+      add_interned_production(lhs, std::move(rhs));
+    }
+
+    /**
+     * Appends the production lhs -> symbols, where symbols may use EBNF
+     *
+     *  ( a b | c )  a group of alternatives
+     *  X*           zero or more X, where X is a symbol or a group
+     *  X+           one or more X
+     *  X?           X or nothing
+     *
+     * Operators and parentheses may be written against the symbols next
+     * to them, like 'ID'* or (',' arg)*. Quoted terminals like '*' are
+     * never operators. A | outside of any group separates alternatives of lhs.
+     *
+     * The result needs no empty productions that symbols didn't ask for,
+     * and lists reduce as they go instead of filling the parse stack
+     *
+     * - Groups and ? are expanded in place, so A -> a b? c becomes
+     *   A -> a c and A -> a b c
+     * - X+ becomes a left recursive helper non-terminal, X+ -> X+ X | X,
+     *   and X* is an optional X+. The helper of a single non-terminal X
+     *   is named X+ and any other helper is named after lhs, like args+1.
+     *   Lists of the same symbols share one helper.
+     *
+     * If the expansions of one alternative would go over MAX_EBNF_EXPANSIONS,
+     * the optional part that does so is moved into a helper with an empty
+     * production instead, named like args?1.
+     *
+     * The productions of lhs come first, then those of any new helpers.
+     * If symbols end with %prec and a terminal, every production of lhs
+     * takes its precedence.
+     *
+     * Throws std::runtime_error on unbalanced parentheses, an operator that
+     * follows nothing, or a misplaced %prec
+     */
+    void add_ebnf_production(int lhs, const std::vector<std::string>& symbols) {
+      std::string text = symbol_names[lhs] + " " + RULE_SEP;
+      for(const std::string& symbol : symbols) {
+        text += " " + symbol;
+      }
+
+      std::vector<std::string> pieces;
+      for(const std::string& symbol : symbols) {
+        split_ebnf_symbol(symbol, pieces);
+      }
+
+      int precedence_symbol = -1;
+      const auto marker = std::find(pieces.begin(), pieces.end(), PREC_MARKER);
+      if(marker != pieces.end()) {
+        if(marker + 2 != pieces.end() || !is_terminal(*(marker + 1))) {
+          throw std::runtime_error(PREC_MARKER + " must be followed by a terminal at the end of " + text);
+        }
+        precedence_symbol = intern_symbol(*(marker + 1));
+        pieces.erase(marker, pieces.end());
+      }
+
+      EbnfHelpers helpers;
+      size_t pos = 0;
+      std::vector<std::vector<int>> expansions = expand_ebnf_alternatives(pieces, pos, lhs, helpers, text);
+      if(pos < pieces.size()) {
+        throw std::runtime_error("unexpected " + GROUP_CLOSE + " in " + text);
+      }
+
+      // Keep the production text in step if it has been built
+      const bool has_text = productions.size() == interned_productions.size();
+
+      for(std::vector<int>& rhs : expansions) {
+        add_interned_production(lhs, std::move(rhs));
+        interned_productions.back().precedence_symbol = precedence_symbol;
+      }
+      for(auto& helper : helpers) {
+        for(std::vector<int>& rhs : helper.second) {
+          add_interned_production(helper.first, std::move(rhs));
+        }
+      }
+
+      if(has_text) {
+        build_production_strings();
+      }
+    }
+
+    // Returns production n with its symbols interned
+    const Production& get_production(size_t n) const {
+      return interned_productions[n];
+    }
+
+    /**
+     * Declares terminals with the same precedence and associativity
+     *
+     * Each declaration gets a higher level than the ones before it,
+     * so with
+     *
+     * %left '+' '-'
+     * %left '*'
+     *
+     * '*' binds tighter than '+' and '-', which bind tighter than
+     * any terminal without a declaration
+     *
+     * A terminal that is only named in declarations and %prec does not
+     * become part of the grammar's terminals
+     * Throws std::runtime_error if a symbol isn't a terminal
+     */
+    void declare_precedence(Associativity associativity, const std::vector<std::string>& symbols) {
+      ++precedence_levels;
+      for(const std::string& symbol : symbols) {
+        if(!is_terminal(symbol)) {
+          throw std::runtime_error("precedence can only be declared for terminals, found " + symbol);
+        }
+
+        symbol_precedence[intern_symbol(symbol)] = {precedence_levels, associativity};
+      }
+    }
+
+    // Returns true if any precedence was declared
+    bool has_precedence() const {
+      return !symbol_precedence.empty();
+    }
+
+    // Returns the declared precedence of symbol, which is empty if there is none
+    Precedence get_precedence(const std::string& symbol) const {
+      const int id = get_symbol_id(symbol);
+      return id >= 0 ? get_precedence(id) : Precedence();
+    }
+
+    Precedence get_precedence(int id) const {
+      const auto found = symbol_precedence.find(id);
+      return found != symbol_precedence.end() ? found->second : Precedence();
     }
 
-    bool empty() {
-      return productions.empty();
+    /**
+     * Gives production n the precedence of the terminal with id symbol,
+     * like ending it with %prec
+     */
+    void set_production_precedence(size_t n, int symbol) {
+      interned_productions[n].precedence_symbol = symbol;
+    }
+
+    /**
+     * Returns the precedence of production n
+     * This is the precedence of its %prec terminal if it has one,
+     * otherwise that of the rightmost terminal in its rhs
+     *
+     * Given E -> E '+' E and %left '+', returns the precedence of '+'
+     */
+    Precedence get_production_precedence(size_t n) const {
+      const Production& production = interned_productions[n];
+      if(production.precedence_symbol >= 0) {
+        return get_precedence(production.precedence_symbol);
+      }
+
+      for(auto it = production.rhs.rbegin(); it != production.rhs.rend(); ++it) {
+        if(is_terminal(symbol_names[*it])) {
+          return get_precedence(*it);
+        }
+      }
+
+      return Precedence();
+    }
+
+    /**
+     * Returns the precedence declarations and %prec markers as text,
+     * one declaration per line from the lowest level
+     * Grammars with the same text resolve conflicts the same way
+     */
+    std::string get_precedence_str() const {
+      std::vector<std::vector<std::string>> levels(precedence_levels + 1);
+      std::vector<Associativity> associativities(precedence_levels + 1, Associativity::NONE);
+      for(const auto& entry : symbol_precedence) {
+        levels[entry.second.level].push_back(symbol_names[entry.first]);
+        associativities[entry.second.level] = entry.second.associativity;
+      }
+
+      std::string str;
+      for(int level = 1; level <= precedence_levels; ++level) {
+        if(levels[level].empty()) {
+          continue;
+        }
+
+        std::sort(levels[level].begin(), levels[level].end());
+        str += get_associativity_declaration(associativities[level]);
+        for(const std::string& symbol : levels[level]) {
+          str += " " + symbol;
+        }
+        str += "\n";
+      }
+
+      for(int i = 0; i < interned_productions.size(); ++i) {
+        if(interned_productions[i].precedence_symbol >= 0) {
+          str += std::to_string(i) + " " + PREC_MARKER + " " + symbol_names[interned_productions[i].precedence_symbol] + "\n";
+        }
+      }
+
+      return str;
+    }
+
+    /**
+     * Returns the indices of the productions of symbol
+     * With grammar
+     * 
+     * A -> B
+     * A -> d
+     * B -> e
+     * 
+     * when given A will return [0, 1]
+     */
+    const std::vector<int>& get_production_indices(const std::string& symbol) const {
+      const static std::vector<int> none;
+
+      const int id = get_symbol_id(symbol);
+      if(id < 0 || id >= productions_by_lhs.size()) {
+        return none;
+      }
+
+      return productions_by_lhs[id];
+    }
+
+    /**
+     * Moves grammar into an immutable snapshot that generators and
+     * parsers can share instead of each keeping a copy
+     *
+     * The text of every production is built first, so nothing in the
+     * snapshot is written to afterwards and it can be read from any thread
+     */
+    static std::shared_ptr<const Grammar> make_snapshot(Grammar grammar) {
+      grammar.build_production_strings();
+      return std::make_shared<const Grammar>(std::move(grammar));
     }
 
     /** 
@@ -143,16 +595,263 @@ class Grammar {
      * Will also add EOF to terminal symbols
      */
     void add_augmented_production() {
-      if(is_augmented()) {
+      if(is_augmented() || empty()) {
         return;
       }
 
-      productions.insert(productions.begin(), get_augmented_production());
-      all_symbols.insert(AUGMENTED_LHS);
-      non_terminals.insert(AUGMENTED_LHS);
+      add_augmented_production({symbol_names[interned_productions[0].lhs]});
+    }
+
+    /**
+     * Inserts an augmented production for each of start_symbols, so one
+     * table can parse from any of them
+     * Does nothing if the grammar has already been augmented
+     *
+     * The first symbol S gets S' -> S and each other symbol A gets
+     * S'A -> A. They are inserted in order ahead of the other productions,
+     * and a table built from the grammar starts in state i to parse
+     * from start symbol i. See get_start_symbols
+     *
+     * With no start_symbols, the lhs of grammar[0] is the start symbol
+     *
+     * Throws std::runtime_error if a symbol has no productions or is
+     * given twice
+     */
+    void add_augmented_production(const std::vector<std::string>& start_symbols) {
+      if(is_augmented() || empty()) {
+        return;
+      }
+      if(start_symbols.empty()) {
+        add_augmented_production();
+        return;
+      }
+
+      std::set<std::string> seen;
+      for(const std::string& symbol : start_symbols) {
+        if(get_production_indices(symbol).empty()) {
+          throw std::runtime_error("start symbol " + symbol + " has no productions");
+        }
+        if(!seen.insert(symbol).second) {
+          throw std::runtime_error("start symbol " + symbol + " is given more than once");
+        }
+      }
+
+      std::vector<Production> augmented;
+      std::vector<std::string> augmented_text;
+      for(size_t i = 0; i < start_symbols.size(); ++i) {
+        const std::string lhs = i == 0 ? AUGMENTED_LHS : AUGMENTED_LHS + start_symbols[i];
+        augmented.push_back(Production{intern_symbol(lhs), {get_symbol_id(start_symbols[i])}});
+        augmented_text.push_back(get_augmented_production(lhs, start_symbols[i]));
+
+        all_symbols.insert(lhs);
+        non_terminals.insert(lhs);
+      }
+
+      // Keep the production text in step if it has been built
+      if(productions.size() == interned_productions.size()) {
+        productions.insert(productions.begin(), augmented_text.begin(), augmented_text.end());
+      }
+      else {
+        productions.clear();
+      }
+
+      interned_productions.insert(interned_productions.begin(), augmented.begin(), augmented.end());
+      index_productions();
+
       terminals.insert(DOLLAR);
     }
 
+    /**
+     * Returns the start symbols of an augmented grammar in order,
+     * the rhs of each augmented production
+     * The table built from the grammar starts in state i to parse
+     * from start symbol i
+     */
+    std::vector<std::string> get_start_symbols() const {
+      std::vector<std::string> start_symbols;
+      for(const Production& production : interned_productions) {
+        if(!is_augmented_symbol(symbol_names[production.lhs])) {
+          break;
+        }
+        start_symbols.push_back(symbol_names[production.rhs[0]]);
+      }
+
+      return start_symbols;
+    }
+
+    // Returns the position of symbol in get_start_symbols, which is
+    // also its start state, or -1 if it is not a start symbol
+    int get_start_index(const std::string& symbol) const {
+      const std::vector<std::string> start_symbols = get_start_symbols();
+      const auto found = std::find(start_symbols.begin(), start_symbols.end(), symbol);
+      return found != start_symbols.end() ? found - start_symbols.begin() : -1;
+    }
+
+    /**
+     * Removes the productions that can never be part of a derivation
+     * of a sentence from the start symbol, the lhs of production 0
+     *
+     * 1. A symbol is productive if it is a terminal or has a production
+     *    whose rhs symbols are all productive. Productions that use an
+     *    unproductive symbol are removed.
+     * 2. A symbol is reachable if it is the start symbol or is on the rhs
+     *    of a remaining production of a reachable symbol. Productions of
+     *    unreachable symbols are removed.
+     *
+     * Symbols that are only used by removed productions are removed too.
+     * The remaining productions keep their order but are renumbered.
+     *
+     * Symbols in start_symbols are reachable as well, for a grammar
+     * that will be augmented with several start symbols
+     *
+     * Throws std::runtime_error if a start symbol itself is unproductive
+     */
+    GrammarReduction remove_useless_productions(const std::vector<std::string>& start_symbols = {}) {
+      GrammarReduction reduction;
+      if(empty()) {
+        return reduction;
+      }
+
+      // 1. Find the productive symbols
+      std::vector<bool> productive(symbol_names.size(), false);
+      for(int id = 0; id < symbol_names.size(); ++id) {
+        productive[id] = is_terminal(symbol_names[id]);
+      }
+
+      bool changed = true;
+      while(changed) {
+        changed = false;
+        for(const Production& production : interned_productions) {
+          if(productive[production.lhs]) {
+            continue;
+          }
+
+          bool all_productive = true;
+          for(int symbol : production.rhs) {
+            all_productive = all_productive && productive[symbol];
+          }
+
+          if(all_productive) {
+            productive[production.lhs] = true;
+            changed = true;
+          }
+        }
+      }
+
+      std::vector<int> starts = {interned_productions[0].lhs};
+      for(const std::string& symbol : start_symbols) {
+        const int id = get_symbol_id(symbol);
+        if(id < 0) {
+          throw std::runtime_error("start symbol " + symbol + " is not in the grammar");
+        }
+        starts.push_back(id);
+      }
+
+      for(int start : starts) {
+        if(!productive[start]) {
+          throw std::runtime_error("start symbol " + symbol_names[start] + " derives no string of terminals");
+        }
+      }
+
+      std::vector<bool> kept(interned_productions.size(), true);
+      for(int i = 0; i < interned_productions.size(); ++i) {
+        const Production& production = interned_productions[i];
+        kept[i] = productive[production.lhs];
+        for(int symbol : production.rhs) {
+          kept[i] = kept[i] && productive[symbol];
+        }
+      }
+
+      // 2. Find the reachable symbols through the kept productions
+      std::vector<bool> reachable(symbol_names.size(), false);
+      std::vector<int> stack;
+      for(int start : starts) {
+        if(!reachable[start]) {
+          reachable[start] = true;
+          stack.push_back(start);
+        }
+      }
+      while(!stack.empty()) {
+        int symbol = stack.back();
+        stack.pop_back();
+
+        for(int i : get_production_indices(symbol_names[symbol])) {
+          if(!kept[i]) {
+            continue;
+          }
+
+          for(int rh_symbol : interned_productions[i].rhs) {
+            if(!reachable[rh_symbol]) {
+              reachable[rh_symbol] = true;
+              stack.push_back(rh_symbol);
+            }
+          }
+        }
+      }
+
+      for(int i = 0; i < interned_productions.size(); ++i) {
+        kept[i] = kept[i] && reachable[interned_productions[i].lhs];
+      }
+
+      // Record what is removed
+      build_production_strings();
+      for(int i = 0; i < interned_productions.size(); ++i) {
+        if(!kept[i]) {
+          reduction.removed_productions.push_back(productions[i]);
+        }
+      }
+
+      for(int id = 0; id < symbol_names.size(); ++id) {
+        const std::string& name = symbol_names[id];
+        if(all_symbols.count(name) == 0) {
+          continue;
+        }
+
+        if(!productive[id]) {
+          reduction.unproductive_symbols.insert(name);
+        }
+        else if(!reachable[id]) {
+          reduction.unreachable_symbols.insert(name);
+        }
+      }
+
+      if(reduction.empty()) {
+        return reduction;
+      }
+
+      // Rebuild the grammar from the kept productions
+      Grammar reduced;
+      for(int i = 0; i < interned_productions.size(); ++i) {
+        if(!kept[i]) {
+          continue;
+        }
+
+        const Production& production = interned_productions[i];
+        std::vector<int> rhs;
+        for(int symbol : production.rhs) {
+          rhs.push_back(reduced.intern_symbol(symbol_names[symbol]));
+        }
+        reduced.add_production(reduced.intern_symbol(symbol_names[production.lhs]), std::move(rhs));
+        reduced.productions.push_back(productions[i]);
+
+        if(production.precedence_symbol >= 0) {
+          reduced.interned_productions.back().precedence_symbol = reduced.intern_symbol(symbol_names[production.precedence_symbol]);
+        }
+      }
+
+      reduced.precedence_levels = precedence_levels;
+      for(const auto& entry : symbol_precedence) {
+        reduced.symbol_precedence[reduced.intern_symbol(symbol_names[entry.first])] = entry.second;
+      }
+
+      if(terminals.count(DOLLAR) > 0) {
+        reduced.terminals.insert(DOLLAR);
+      }
+
+      *this = std::move(reduced);
+      return reduction;
+    }
+
     /** 
      * Returns a set containing all the symbols in str
      * Assumes symbols are space deliminated
@@ -178,29 +877,276 @@ class Grammar {
 
       return symbols;
     }
+
+    // Returns true if symbol is or contains EBNF syntax, like (, 'ID'* or |
+    static bool is_ebnf_symbol(const std::string& symbol) {
+      if(symbol.empty() || is_terminal(symbol)) {
+        return false;
+      }
+
+      return symbol == ALTERNATIVE_SEP ||
+        symbol.front() == GROUP_OPEN[0] ||
+        symbol.back() == GROUP_CLOSE[0] ||
+        EBNF_OPERATORS.find(symbol.back()) != std::string::npos;
+    }
+
+    /**
+     * Appends the pieces of symbol to pieces, splitting off the
+     * parentheses and operators written against it
+     *
+     * Given (',' appends ( and ','
+     * Given arg)* appends arg, ) and *
+     * Given '*' appends '*'
+     */
+    static void split_ebnf_symbol(const std::string& symbol, std::vector<std::string>& pieces) {
+      size_t begin = 0;
+      size_t end = symbol.size();
+      auto is_quoted = [&]() {
+        return is_terminal(symbol.substr(begin, end - begin));
+      };
+
+      while(begin < end && symbol[begin] == GROUP_OPEN[0] && !is_quoted()) {
+        pieces.push_back(GROUP_OPEN);
+        ++begin;
+      }
+
+      size_t suffix = end;
+      while(end > begin && !is_quoted() && (symbol[end - 1] == GROUP_CLOSE[0] || EBNF_OPERATORS.find(symbol[end - 1]) != std::string::npos)) {
+        --end;
+      }
+
+      if(end > begin) {
+        pieces.push_back(symbol.substr(begin, end - begin));
+      }
+      for(; end < suffix; ++end) {
+        pieces.push_back(std::string(1, symbol[end]));
+      }
+    }
   private:
-    std::vector<std::string> productions;
+    // The text of each production
+    // Built on demand for productions added from interned ids,
+    // so it may only hold the first few productions
+    mutable std::vector<std::string> productions;
+
+    // The productions with their symbols interned
+    std::vector<Production> interned_productions;
+
+    // Maps a symbol id to the indices of its productions
+    std::vector<std::vector<int>> productions_by_lhs;
+
+    // Maps a symbol id to its name
+    std::vector<std::string> symbol_names;
+
+    // Maps a symbol name to its id
+    std::unordered_map<std::string, int> symbol_ids;
 
     std::set<std::string> all_symbols;
     std::set<std::string> non_terminals;
     std::set<std::string> terminals;
 
-    /** Creates an augmented grammar rule for the given grammar
-     * Assumes grammar[0] is the original starting rule
-     * Assumes S' is not already part of the grammar and
-     * can be used as the augmented lhs
+    // Maps a terminal id to its declared precedence
+    std::unordered_map<int, Precedence> symbol_precedence;
+
+    // The number of precedence declarations so far
+    int precedence_levels = 0;
+
+    // Stores an interned production and records its symbols
+    void add_interned_production(int lhs, std::vector<int> rhs) {
+      const std::string& lhs_name = symbol_names[lhs];
+      non_terminals.insert(lhs_name);
+      all_symbols.insert(lhs_name);
+
+      for(int symbol : rhs) {
+        const std::string& name = symbol_names[symbol];
+        is_terminal(name) ? terminals.insert(name) : non_terminals.insert(name);
+        all_symbols.insert(name);
+      }
+
+      if(lhs >= productions_by_lhs.size()) {
+        productions_by_lhs.resize(lhs + 1);
+      }
+      productions_by_lhs[lhs].push_back(interned_productions.size());
+
+      interned_productions.push_back({lhs, std::move(rhs)});
+    }
+
+    // The new helper non-terminals of an EBNF production and
+    // their productions, in the order they were made
+    using EbnfHelpers = std::vector<std::pair<int, std::vector<std::vector<int>>>>;
+
+    // Expands the alternatives of an EBNF rhs from pieces[pos] up to
+    // a ) or the end, returning the rhs of each expansion
+    std::vector<std::vector<int>> expand_ebnf_alternatives(const std::vector<std::string>& pieces, size_t& pos, int lhs, EbnfHelpers& helpers, const std::string& text) {
+      std::vector<std::vector<int>> alternatives = expand_ebnf_sequence(pieces, pos, lhs, helpers, text);
+      while(pos < pieces.size() && pieces[pos] == ALTERNATIVE_SEP) {
+        ++pos;
+        std::vector<std::vector<int>> more = expand_ebnf_sequence(pieces, pos, lhs, helpers, text);
+        alternatives.insert(alternatives.end(), more.begin(), more.end());
+      }
+
+      return alternatives;
+    }
+
+    // Expands one alternative, the product of the expansions of its items
+    std::vector<std::vector<int>> expand_ebnf_sequence(const std::vector<std::string>& pieces, size_t& pos, int lhs, EbnfHelpers& helpers, const std::string& text) {
+      std::vector<std::vector<int>> expansions = {{}};
+
+      while(pos < pieces.size() && pieces[pos] != ALTERNATIVE_SEP && pieces[pos] != GROUP_CLOSE) {
+        const std::string& piece = pieces[pos++];
+
+        std::vector<std::vector<int>> options;
+        if(piece == GROUP_OPEN) {
+          options = expand_ebnf_alternatives(pieces, pos, lhs, helpers, text);
+          if(pos == pieces.size()) {
+            throw std::runtime_error("expected " + GROUP_CLOSE + " to close " + GROUP_OPEN + " in " + text);
+          }
+          ++pos;
+        }
+        else if(piece == EPSILON) {
+          options = {{}};
+        }
+        else if(piece.size() == 1 && EBNF_OPERATORS.find(piece[0]) != std::string::npos) {
+          throw std::runtime_error(piece + " must follow a symbol or group in " + text);
+        }
+        else if(piece == RULE_SEP || piece == PREC_MARKER || (piece[0] == '\'' && !is_terminal(piece))) {
+          throw std::runtime_error("unexpected " + piece + " in " + text);
+        }
+        else {
+          options = {{intern_symbol(piece)}};
+        }
+
+        while(pos < pieces.size() && pieces[pos].size() == 1 && EBNF_OPERATORS.find(pieces[pos][0]) != std::string::npos) {
+          options = apply_ebnf_operator(pieces[pos++][0], std::move(options), lhs, helpers);
+        }
+
+        if(expansions.size() * options.size() > MAX_EBNF_EXPANSIONS && options.size() > 1) {
+          options = {{add_ebnf_helper(lhs, options, false, helpers)}};
+        }
+
+        std::vector<std::vector<int>> product;
+        for(const std::vector<int>& expansion : expansions) {
+          for(const std::vector<int>& option : options) {
+            product.push_back(expansion);
+            product.back().insert(product.back().end(), option.begin(), option.end());
+          }
+        }
+        expansions = std::move(product);
+      }
+
+      return expansions;
+    }
+
+    /**
+     * Applies the EBNF operator op to the expansions of an item
+     * Empty expansions are kept out of list helpers, so (a?)+ is a*
+     */
+    std::vector<std::vector<int>> apply_ebnf_operator(char op, std::vector<std::vector<int>> options, int lhs, EbnfHelpers& helpers) {
+      const auto empty = std::remove_if(options.begin(), options.end(), [](const std::vector<int>& option) { return option.empty(); });
+      const bool had_empty = empty != options.end();
+      options.erase(empty, options.end());
+
+      if(op == '?' || options.empty()) {
+        options.insert(options.begin(), std::vector<int>());
+        return options;
+      }
+
+      const int list = add_ebnf_helper(lhs, options, true, helpers);
+      if(op == '*' || had_empty) {
+        return {{}, {list}};
+      }
+
+      return {{list}};
+    }
+
+    /**
+     * Returns a helper non-terminal for options, reusing one with the
+     * same productions if there is one
      *
-     * Given grammar[0] as S -> E, will return S' -> S
-     * 
+     * A list helper L has L -> L option and L -> option for each option,
+     * any other helper has L -> option
      */
-    std::string get_augmented_production() {
-      // Nothing to do with no rules
-      if(empty()) {
-        return "";
+    int add_ebnf_helper(int lhs, const std::vector<std::vector<int>>& options, bool list, EbnfHelpers& helpers) {
+      // A terminal's helper is named after lhs too, as a name like ','+
+      // would read as a terminal in a table header
+      const bool single = list && options.size() == 1 && options[0].size() == 1 && !is_terminal(symbol_names[options[0][0]]);
+      const std::string base = (single ? symbol_names[options[0][0]] : symbol_names[lhs]) + (list ? "+" : "?");
+
+      auto helper_productions = [&](int helper) {
+        std::vector<std::vector<int>> rhs;
+        if(list) {
+          for(const std::vector<int>& option : options) {
+            rhs.push_back({helper});
+            rhs.back().insert(rhs.back().end(), option.begin(), option.end());
+          }
+        }
+        rhs.insert(rhs.end(), options.begin(), options.end());
+        return rhs;
+      };
+
+      for(int n = 1; ; ++n) {
+        const std::string name = single && n == 1 ? base : base + std::to_string(n);
+        const int id = get_symbol_id(name);
+        if(id < 0) {
+          const int helper = intern_symbol(name);
+          helpers.emplace_back(helper, helper_productions(helper));
+          return helper;
+        }
+
+        // An existing helper can be reused if its productions match
+        const std::vector<std::vector<int>> wanted = helper_productions(id);
+        std::vector<std::vector<int>> existing;
+        for(int i : get_production_indices(name)) {
+          existing.push_back(interned_productions[i].rhs);
+        }
+        for(const auto& helper : helpers) {
+          if(helper.first == id) {
+            existing = helper.second;
+          }
+        }
+
+        if(existing == wanted) {
+          return id;
+        }
       }
+    }
+
+    // Rebuilds productions_by_lhs after productions have been reordered
+    void index_productions() {
+      productions_by_lhs.assign(symbol_names.size(), std::vector<int>());
+      for(int i = 0; i < interned_productions.size(); ++i) {
+        productions_by_lhs[interned_productions[i].lhs].push_back(i);
+      }
+    }
+
+    // Builds the text of any production that does not have it yet
+    // Given lhs A and rhs [B, 'c'] the text is A -> B 'c'
+    void build_production_strings() const {
+      productions.reserve(interned_productions.size());
+
+      for(size_t i = productions.size(); i < interned_productions.size(); ++i) {
+        const Production& production = interned_productions[i];
 
-      std::string lhs = get_LHS(productions[0]);
-      return AUGMENTED_LHS + " " + RULE_SEP + " " + lhs;
+        std::string text = symbol_names[production.lhs] + " " + RULE_SEP;
+        for(int symbol : production.rhs) {
+          text += " " + symbol_names[symbol];
+        }
+        if(production.rhs.empty()) {
+          text += " " + EPSILON;
+        }
+
+        productions.push_back(std::move(text));
+      }
+    }
+
+    /** Creates an augmented grammar rule for start_symbol
+     * Assumes lhs is not already part of the grammar and
+     * can be used as the augmented lhs
+     *
+     * Given S' and S, will return S' -> S
+     * 
+     */
+    static std::string get_augmented_production(const std::string& lhs, const std::string& start_symbol) {
+      return lhs + " " + RULE_SEP + " " + start_symbol;
     }
 
     // Checks for a AUGMENTED_LHS symbol in non_terminals
@@ -0,0 +1,376 @@
+#ifndef _GRAMMAR_LOADER_HPP_
+#define _GRAMMAR_LOADER_HPP_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "grammar.hpp"
+
+// Starts a comment that runs to the end of the line in a grammar file
+const static char COMMENT_CHAR = '#';
+
+/**
+ * Thrown when a grammar file can't be read or parsed
+ * Line and column are 1 based, or 0 if the error isn't tied to a position
+ */
+class GrammarLoadError : public std::runtime_error {
+  public:
+    GrammarLoadError(const std::string& source, int line, int column, const std::string& message) :
+      std::runtime_error(source + ":" + std::to_string(line) + ":" + std::to_string(column) + ": " + message),
+      line(line),
+      column(column) {}
+
+    int get_line() const {
+      return line;
+    }
+
+    int get_column() const {
+      return column;
+    }
+
+  private:
+    int line;
+    int column;
+};
+
+/**
+ * Loads the productions in data into grammar
+ *
+ * The format is one rule per line, with the same symbols as the
+ * production strings given to Grammar
+ *
+ *  # comments run to the end of the line
+ *  content -> content 'PASSTHROUGH' | 'PASSTHROUGH'
+ *  args -> arg_list
+ *       | ~
+ *
+ * A line starting with | adds another alternative to the rule above it.
+ * Symbols must be separated by whitespace, except for EBNF parentheses
+ * and operators, see Grammar::add_ebnf_production. A group must close
+ * on the line it opens on.
+ *
+ *  call -> 'ID' '(' ( expression ( ',' expression )* )? ')'
+ *
+ * Precedence is declared as in yacc, one level per line from the
+ * loosest binding, and an alternative can take the precedence of
+ * another terminal with %prec
+ *
+ *  %left '+' '-'
+ *  %left '*'
+ *  %right 'UMINUS'
+ *  expression -> expression '+' expression
+ *             | '-' expression %prec 'UMINUS'
+ *
+ * data is tokenized in a single pass and each symbol is interned
+ * straight into grammar, so no text is built per production.
+ * Only alternatives that use EBNF keep their tokens to expand them.
+ *
+ * source names data in error messages
+ * Throws GrammarLoadError on malformed input or if data has no rules
+ */
+void load_grammar(const char* data, size_t size, const std::string& source, Grammar& grammar) {
+  int line = 1;
+  size_t line_start = 0;
+  size_t pos = 0;
+
+  // The lhs of the rule being read, or -1 before the first rule
+  int lhs = -1;
+  bool seen_rule_sep = false;
+
+  std::vector<int> rhs;
+  bool rhs_is_epsilon = false;
+
+  // The tokens of the current alternative if it uses EBNF
+  std::vector<std::string> ebnf_symbols;
+  std::vector<std::string> ebnf_pieces;
+  int group_depth = 0;
+
+  // The %prec terminal of the current alternative, or -1
+  int rhs_precedence = -1;
+  bool expect_precedence_symbol = false;
+
+  // Set while reading the terminals of a precedence declaration
+  Associativity declaration = Associativity::NONE;
+  std::vector<std::string> declared_symbols;
+
+  // Position of the start of the current alternative for errors
+  int alternative_line = 0;
+  int alternative_column = 0;
+
+  // Reused for every token so interning does not allocate
+  std::string token;
+
+  auto error = [&](int error_line, int error_column, const std::string& message) {
+    return GrammarLoadError(source, error_line, error_column, message);
+  };
+
+  // Adds the alternative read so far as a production of lhs
+  auto end_alternative = [&]() {
+    if(rhs.empty() && !rhs_is_epsilon && ebnf_symbols.empty()) {
+      throw error(alternative_line, alternative_column, "empty alternative, use " + EPSILON + " for an empty production");
+    }
+
+    if(expect_precedence_symbol) {
+      throw error(alternative_line, alternative_column, "expected a terminal after " + PREC_MARKER);
+    }
+
+    if(!ebnf_symbols.empty()) {
+      if(rhs_precedence >= 0) {
+        ebnf_symbols.push_back(PREC_MARKER);
+        ebnf_symbols.push_back(grammar.get_symbol(rhs_precedence));
+      }
+
+      try {
+        grammar.add_ebnf_production(lhs, ebnf_symbols);
+      }
+      catch(const std::runtime_error& e) {
+        throw error(alternative_line, alternative_column, e.what());
+      }
+    }
+    else {
+      grammar.add_production(lhs, std::move(rhs));
+      if(rhs_precedence >= 0) {
+        grammar.set_production_precedence(grammar.size() - 1, rhs_precedence);
+      }
+    }
+
+    ebnf_symbols.clear();
+    group_depth = 0;
+    rhs.clear();
+    rhs_is_epsilon = false;
+    rhs_precedence = -1;
+  };
+
+  // Set once a line has had a rule or an alternative
+  bool in_rule = false;
+
+  while(pos <= size) {
+    // End of the line or the data
+    if(pos == size || data[pos] == '\n') {
+      if(declaration != Associativity::NONE) {
+        grammar.declare_precedence(declaration, declared_symbols);
+        declaration = Associativity::NONE;
+      }
+
+      if(in_rule) {
+        if(!seen_rule_sep) {
+          throw error(alternative_line, alternative_column, "expected " + RULE_SEP + " after " + grammar.get_symbol(lhs));
+        }
+        end_alternative();
+        in_rule = false;
+      }
+
+      ++pos;
+      ++line;
+      line_start = pos;
+      continue;
+    }
+
+    if(std::isspace((unsigned char)data[pos])) {
+      ++pos;
+      continue;
+    }
+
+    const size_t start = pos;
+    const int column = start - line_start + 1;
+
+    if(data[pos] == COMMENT_CHAR) {
+      while(pos < size && data[pos] != '\n') {
+        ++pos;
+      }
+      continue;
+    }
+
+    while(pos < size && !std::isspace((unsigned char)data[pos])) {
+      ++pos;
+    }
+    token.assign(data + start, pos - start);
+
+    if(declaration != Associativity::NONE) {
+      if(!is_terminal(token)) {
+        throw error(line, column, "expected a terminal in " + get_associativity_declaration(declaration) + ", found " + token);
+      }
+
+      declared_symbols.push_back(token);
+      continue;
+    }
+
+    if(expect_precedence_symbol) {
+      if(!is_terminal(token)) {
+        throw error(line, column, "expected a terminal after " + PREC_MARKER + ", found " + token);
+      }
+
+      rhs_precedence = grammar.intern_symbol(token);
+      expect_precedence_symbol = false;
+      continue;
+    }
+
+    if(rhs_precedence >= 0 && token != ALTERNATIVE_SEP) {
+      throw error(line, column, PREC_MARKER + " must be at the end of an alternative");
+    }
+
+    if(token == ALTERNATIVE_SEP && group_depth == 0) {
+      if(lhs < 0) {
+        throw error(line, column, "alternative without a rule");
+      }
+
+      if(in_rule) {
+        end_alternative();
+      }
+      else {
+        // A continuation line of the previous rule
+        in_rule = true;
+        seen_rule_sep = true;
+      }
+
+      alternative_line = line;
+      alternative_column = column + 1;
+      continue;
+    }
+
+    if(!in_rule && get_declaration_associativity(token) != Associativity::NONE) {
+      declaration = get_declaration_associativity(token);
+      declared_symbols.clear();
+      continue;
+    }
+
+    if(!in_rule) {
+      // Start of a new rule
+      if(is_terminal(token) || token == EPSILON || token == RULE_SEP) {
+        throw error(line, column, "expected a non-terminal on the left hand side, found " + token);
+      }
+      if(is_augmented_symbol(token)) {
+        throw error(line, column, "symbols starting with " + AUGMENTED_LHS + " are reserved for augmented start symbols");
+      }
+
+      lhs = grammar.intern_symbol(token);
+      in_rule = true;
+      seen_rule_sep = false;
+      alternative_line = line;
+      alternative_column = column;
+      continue;
+    }
+
+    if(!seen_rule_sep) {
+      if(token != RULE_SEP) {
+        throw error(line, column, "expected " + RULE_SEP + " after " + grammar.get_symbol(lhs) + ", found " + token);
+      }
+
+      seen_rule_sep = true;
+      alternative_column = column + RULE_SEP.size();
+      continue;
+    }
+
+    if(token == RULE_SEP) {
+      throw error(line, column, "unexpected " + RULE_SEP + ", each rule must be on its own line");
+    }
+
+    if(token == PREC_MARKER) {
+      if((rhs.empty() && !rhs_is_epsilon && ebnf_symbols.empty()) || group_depth > 0) {
+        throw error(line, column, PREC_MARKER + " must follow the symbols of an alternative");
+      }
+
+      expect_precedence_symbol = true;
+      continue;
+    }
+
+    if(group_depth > 0 || !ebnf_symbols.empty() || Grammar::is_ebnf_symbol(token)) {
+      if(rhs_is_epsilon) {
+        throw error(line, column, EPSILON + " must be the only symbol of an alternative");
+      }
+
+      // Symbols read before the first EBNF token were interned already
+      for(int symbol : rhs) {
+        ebnf_symbols.push_back(grammar.get_symbol(symbol));
+      }
+      rhs.clear();
+
+      ebnf_pieces.clear();
+      Grammar::split_ebnf_symbol(token, ebnf_pieces);
+      for(const std::string& piece : ebnf_pieces) {
+        group_depth += piece == GROUP_OPEN ? 1 : piece == GROUP_CLOSE ? -1 : 0;
+      }
+
+      ebnf_symbols.push_back(token);
+      continue;
+    }
+
+    if(token[0] == '\'' && !is_terminal(token)) {
+      throw error(line, column, "unterminated terminal " + token);
+    }
+
+    if(token == EPSILON || rhs_is_epsilon) {
+      if(!rhs.empty() || rhs_is_epsilon) {
+        throw error(line, column, EPSILON + " must be the only symbol of an alternative");
+      }
+
+      rhs_is_epsilon = true;
+      continue;
+    }
+
+    rhs.push_back(grammar.intern_symbol(token));
+  }
+
+  if(lhs < 0) {
+    throw error(0, 0, "grammar has no productions");
+  }
+}
+
+/**
+ * Memory maps the grammar file at path and loads its productions
+ * into a new grammar
+ *
+ * Throws GrammarLoadError if the file can't be read, is malformed
+ * or has no rules
+ */
+Grammar load_grammar_file(const std::string& path) {
+  Grammar grammar;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw GrammarLoadError(path, 0, 0, strerror(errno));
+  }
+
+  struct stat file_stat;
+  if(fstat(fd, &file_stat) != 0) {
+    int fstat_errno = errno;
+    close(fd);
+    throw GrammarLoadError(path, 0, 0, strerror(fstat_errno));
+  }
+
+  const size_t size = file_stat.st_size;
+  if(size == 0) {
+    close(fd);
+    throw GrammarLoadError(path, 0, 0, "grammar has no productions");
+  }
+
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int mmap_errno = errno;
+  close(fd);
+
+  if(data == MAP_FAILED) {
+    throw GrammarLoadError(path, 0, 0, strerror(mmap_errno));
+  }
+
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  try {
+    load_grammar(static_cast<const char*>(data), size, path, grammar);
+  }
+  catch(...) {
+    munmap(data, size);
+    throw;
+  }
+
+  munmap(data, size);
+  return grammar;
+}
+
+#endif /* _GRAMMAR_LOADER_HPP_ */
@@ -0,0 +1,607 @@
+#ifndef _INCREMENTAL_PARSER_HPP_
+#define _INCREMENTAL_PARSER_HPP_
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "grammar.hpp"
+#include "lr_parser.hpp"
+#include "parse_table_generator.hpp"
+#include "scanner.hpp"
+
+/**
+ * A node of the parse tree kept by IncrementalParser
+ *
+ * A node only knows how many tokens it covers, not where they are, so
+ * an edit before it doesn't touch it. Nodes never change once built
+ * and are shared by the trees of successive parses.
+ */
+struct SyntaxNode {
+  // The table column of the token, or of the lhs of production
+  int symbol;
+
+  // The production reduced by, or -1 for a token
+  int production;
+
+  // The state below the node on the parse stack
+  int pre_state;
+
+  // The number of tokens the node covers, 0 for an ε production
+  size_t token_count;
+
+  std::vector<SyntaxNode*> children;
+
+  // The number of parents the node has, plus one for a root
+  int refs = 0;
+
+  SyntaxNode(int symbol, int production, int pre_state, size_t token_count) :
+    symbol(symbol),
+    production(production),
+    pre_state(pre_state),
+    token_count(token_count) {}
+
+  bool is_token() const {
+    return production < 0;
+  }
+};
+
+/**
+ * A token of the text an IncrementalParser holds
+ */
+struct LexedToken {
+  int id;
+  size_t start;
+  size_t length;
+
+  // One past the last byte the scanner read to find this token, the text
+  // skipped before it, or any token before it. An edit at or after it
+  // can't change the token.
+  size_t scanned_end;
+
+  size_t end() const {
+    return start + length;
+  }
+};
+
+/**
+ * How much work the last parse of an IncrementalParser did
+ */
+struct ReparseStats {
+  // Tokens the scanner read again
+  size_t relexed_tokens = 0;
+
+  // Subtrees and tokens of the previous tree in the new one,
+  // and the tokens they cover
+  size_t reused_nodes = 0;
+  size_t reused_tokens = 0;
+
+  // Nodes built by this parse
+  size_t built_nodes = 0;
+};
+
+/**
+ * Keeps a text parsed as it is edited, redoing only the work an edit affects
+ *
+ * The text is split into tokens by a Scanner and parsed with the LR
+ * parsing algorithm, like LRParser, but the parser keeps the parse tree.
+ * Each node records the state below it on the stack.
+ *
+ * After an edit, the scanner starts again at the first token that read
+ * a byte the edit changed, and stops once a token ends where an old
+ * token ended, past the edit. From there on the old tokens still hold.
+ *
+ * The parser then reads the old tree as a stream of subtrees in place of
+ * tokens, after Wagner and Graham's incremental LR parsing. A subtree
+ * that covers no changed token, and whose lookahead after it is unchanged,
+ * is shifted whole whenever the parser is in the state the subtree was
+ * built above. The parse would have built it again from that state,
+ * since it would read the same tokens. Other subtrees are broken down
+ * into their children. Only the nodes along the way from the root to
+ * the edit are rebuilt, so the work done follows the size of the edit
+ * and the depth of the tree instead of the size of the text. The text
+ * and the token array are still spliced, which moves the tokens after
+ * the edit but doesn't scan or parse them again.
+ *
+ * Tokens are matched by their ids, so an edit that changes a token's
+ * text but not its terminal, like renaming an 'ID', reuses the whole tree.
+ *
+ * table, grammar and the lexer's token ids must be the same as for LRParser
+ * with a lexer. The parser is not thread safe, but parsers of different
+ * texts can share the table if it can be shared.
+ */
+template<typename Table>
+class IncrementalParser {
+  public:
+    IncrementalParser(const Grammar& grammar, const Table& table, const LexerTables& lexer, int start_state = 0) :
+      table(table),
+      scanner(lexer),
+      end_token(lexer.end_token),
+      start_state(start_state) {
+      for(size_t i = 0; i < grammar.size(); ++i) {
+        const Production& production = grammar.get_production(i);
+        lhs_cols.push_back(table.get_column(grammar.get_symbol(production.lhs)));
+        rhs_sizes.push_back(production.rhs.size());
+      }
+    }
+
+    ~IncrementalParser() {
+      if(root) {
+        release(root);
+      }
+    }
+
+    // The parser owns its tree
+    IncrementalParser(const IncrementalParser&) = delete;
+    IncrementalParser& operator=(const IncrementalParser&) = delete;
+
+    /**
+     * Replaces the whole text and parses it from scratch
+     * Throws as edit does
+     */
+    void set_text(const std::string& new_text) {
+      text = new_text;
+      tokens.clear();
+      if(root) {
+        release(root);
+        root = nullptr;
+      }
+
+      damaged = true;
+      reparse();
+    }
+
+    /**
+     * Replaces the removed bytes at offset with inserted and reparses
+     *
+     * Throws std::out_of_range if the bytes are not in the text, and
+     * ScanError or ParseError if the new text is not a sentence. The
+     * text is edited either way. The tree stays the tree of the last
+     * text that parsed, and the next edit reparses everything changed
+     * since then.
+     */
+    void edit(size_t offset, size_t removed, const std::string& inserted) {
+      if(offset > text.size() || removed > text.size() - offset) {
+        throw std::out_of_range("edit of " + std::to_string(removed) + " bytes at " + std::to_string(offset) + " is past the end of the text");
+      }
+      text.replace(offset, removed, inserted);
+
+      // Widen the bytes changed since the last parse to cover this edit
+      if(!damaged) {
+        damage_start = offset;
+        damage_old_end = offset + removed;
+        damage_new_end = offset + inserted.size();
+      }
+      else {
+        const size_t end = std::max(damage_new_end, offset + removed);
+        damage_start = std::min(damage_start, offset);
+        damage_old_end += end - damage_new_end;
+        damage_new_end = end - removed + inserted.size();
+      }
+      damaged = true;
+
+      reparse();
+    }
+
+    const std::string& get_text() const {
+      return text;
+    }
+
+    // Returns the tokens of the tree, ending with the end of the input
+    const std::vector<LexedToken>& get_tokens() const {
+      return tokens;
+    }
+
+    // Returns the root of the tree, or null if no text has parsed yet
+    const SyntaxNode* get_root() const {
+      return root;
+    }
+
+    const ReparseStats& get_stats() const {
+      return stats;
+    }
+
+    /**
+     * Returns the productions of the tree in the order a parse reduces by
+     * them, the same as LRParser::parse
+     */
+    std::vector<int> get_reductions() const {
+      std::vector<int> reductions;
+      if(!root) {
+        return reductions;
+      }
+
+      // Post-order, with the number of children already visited
+      std::vector<std::pair<const SyntaxNode*, size_t>> path = {{root, 0}};
+      while(!path.empty()) {
+        auto& top = path.back();
+        if(top.second < top.first->children.size()) {
+          const SyntaxNode* child = top.first->children[top.second++];
+          if(!child->is_token()) {
+            path.emplace_back(child, 0);
+          }
+          continue;
+        }
+
+        reductions.push_back(top.first->production);
+        path.pop_back();
+      }
+
+      return reductions;
+    }
+
+  private:
+    struct StackEntry {
+      int state;
+      SyntaxNode* node;
+    };
+
+    const Table& table;
+    Scanner scanner;
+    int end_token;
+    int start_state;
+
+    // The goto column of the lhs of each production
+    std::vector<int> lhs_cols;
+
+    // The number of symbols to pop when reducing by each production
+    std::vector<size_t> rhs_sizes;
+
+    std::string text;
+
+    // The tokens and tree of the last text that parsed
+    std::vector<LexedToken> tokens;
+    SyntaxNode* root = nullptr;
+
+    // The bytes changed since then, at [damage_start, damage_old_end)
+    // in that text and [damage_start, damage_new_end) in text
+    bool damaged = false;
+    size_t damage_start = 0;
+    size_t damage_old_end = 0;
+    size_t damage_new_end = 0;
+
+    ReparseStats stats;
+
+    // The tokens scanned again, which take the place of the old tokens
+    // [relex_start, relex_end), and the scanned_end after them
+    std::vector<LexedToken> relexed;
+    size_t relex_start;
+    size_t relex_end;
+    size_t relexed_scanned_end;
+
+    // Of the tokens being parsed, those before prefix_end and from
+    // new_suffix_start on have the ids of the old tokens before prefix_end
+    // and from old_suffix_start on, and only those between changed
+    size_t prefix_end;
+    size_t old_suffix_start;
+    size_t new_suffix_start;
+
+    // The old tree as a stream of subtrees, the next one at the back,
+    // and the index of its first old token
+    std::vector<SyntaxNode*> old_nodes;
+    size_t old_position;
+
+    // Relexes and reparses the damaged text, then swaps in the new tree
+    void reparse() {
+      stats = ReparseStats();
+      relex();
+
+      old_nodes.clear();
+      old_position = 0;
+      if(root) {
+        old_nodes.push_back(root);
+      }
+
+      SyntaxNode* new_root = parse();
+      ++new_root->refs;
+      if(root) {
+        release(root);
+      }
+      root = new_root;
+      splice_tokens();
+      damaged = false;
+    }
+
+    /**
+     * Splits the damaged text into relexed, starting at the first old token
+     * the damage could have changed, and sets the ranges above
+     * Throws ScanError at the first byte no token matches
+     */
+    void relex() {
+      relexed.clear();
+      const bool have_tokens = root && !tokens.empty();
+
+      // Tokens whose scan stopped before the damage are unchanged,
+      // and scanned_end only grows along the tokens
+      relex_start = 0;
+      if(have_tokens) {
+        relex_start = std::partition_point(tokens.begin(), tokens.end() - 1, [&](const LexedToken& token) {
+          return token.scanned_end <= damage_start;
+        }) - tokens.begin();
+      }
+
+      size_t position = relex_start > 0 ? tokens[relex_start - 1].end() : 0;
+      size_t scanned_end = relex_start > 0 ? tokens[relex_start - 1].scanned_end : 0;
+
+      // Scans until a token ends past the damage where an old token ended,
+      // since the scanner would go on from there the same as before
+      const size_t old_end = have_tokens ? tokens.size() - 1 : 0;
+      size_t old = relex_start;
+      relex_end = old_end;
+      bool in_sync = false;
+      while(position < text.size() && !in_sync) {
+        int id = SKIP_TOKEN;
+        size_t length = 0;
+        while(position < text.size()) {
+          size_t scanned;
+          id = scanner.next_token(text.data(), text.size(), position, length, scanned);
+          if(id == NO_TOKEN || length == 0) {
+            throw ScanError(position);
+          }
+          scanned_end = std::max(scanned_end, position + scanned);
+
+          if(id != SKIP_TOKEN) {
+            break;
+          }
+          position += length;
+        }
+        if(id == SKIP_TOKEN) {
+          break;
+        }
+
+        relexed.push_back({id, position, length, scanned_end});
+        position += length;
+        ++stats.relexed_tokens;
+
+        if(have_tokens && position >= damage_new_end) {
+          const size_t old_byte = position - damage_new_end + damage_old_end;
+          while(old < old_end && tokens[old].end() < old_byte) {
+            ++old;
+          }
+          if(old < old_end && tokens[old].end() == old_byte) {
+            relex_end = old + 1;
+            in_sync = true;
+          }
+        }
+      }
+      relexed_scanned_end = scanned_end;
+
+      prefix_end = relex_start;
+      old_suffix_start = relex_end;
+      new_suffix_start = relex_start + relexed.size();
+      if(!have_tokens) {
+        relexed.push_back({end_token, text.size(), 0, text.size() + 1});
+        return;
+      }
+
+      // Relexed tokens with the same ids as the old ones parse the same
+      while(prefix_end < new_suffix_start && prefix_end < old_suffix_start && get_token_id(prefix_end) == tokens[prefix_end].id) {
+        ++prefix_end;
+      }
+      while(new_suffix_start > prefix_end && old_suffix_start > prefix_end && get_token_id(new_suffix_start - 1) == tokens[old_suffix_start - 1].id) {
+        --new_suffix_start;
+        --old_suffix_start;
+      }
+    }
+
+    // Returns the id of the token at position in the text being parsed
+    int get_token_id(size_t position) const {
+      if(position < relex_start) {
+        return tokens[position].id;
+      }
+      if(position - relex_start < relexed.size()) {
+        return relexed[position - relex_start].id;
+      }
+
+      return tokens[position - relex_start - relexed.size() + relex_end].id;
+    }
+
+    // Replaces the old tokens [relex_start, relex_end) with relexed,
+    // moving the tokens after them by the bytes the damage added or removed
+    void splice_tokens() {
+      if(tokens.empty()) {
+        tokens.swap(relexed);
+        return;
+      }
+
+      size_t scanned_end = relexed_scanned_end;
+      for(size_t i = relex_end; i + 1 < tokens.size(); ++i) {
+        LexedToken& token = tokens[i];
+        token.start = token.start - damage_old_end + damage_new_end;
+        token.scanned_end = std::max(token.scanned_end - damage_old_end + damage_new_end, scanned_end);
+        scanned_end = token.scanned_end;
+      }
+      tokens.back() = {end_token, text.size(), 0, text.size() + 1};
+
+      // Moves the tokens after them once, then copies relexed in
+      const size_t replaced = relex_end - relex_start;
+      if(relexed.size() > replaced) {
+        tokens.insert(tokens.begin() + relex_end, relexed.size() - replaced, LexedToken());
+      }
+      else {
+        tokens.erase(tokens.begin() + relex_start + relexed.size(), tokens.begin() + relex_end);
+      }
+      std::copy(relexed.begin(), relexed.end(), tokens.begin() + relex_start);
+    }
+
+    /**
+     * Parses the new tokens, shifting whole subtrees of the old tree where it can
+     * Algorithm from Dragon book 4.5.3, see LRParser::parse, with an old
+     * subtree in state s shifted like a token on GOTO[s, A] if s is the state
+     * it was built above
+     *
+     * Returns the root of the new tree, with the nodes not yet counted as held
+     * Throws ParseError at the first token without an action
+     */
+    SyntaxNode* parse() {
+      std::vector<StackEntry> stack = {{start_state, nullptr}};
+
+      try {
+        size_t position = 0;
+        while(true) {
+          SyntaxNode* subtree = next_subtree(position);
+          const int col = get_token_id(position);
+          const int state = stack.back().state;
+
+          if(subtree && !subtree->is_token()) {
+            if(subtree->pre_state == state) {
+              stack.push_back({get_goto(state, subtree->symbol), subtree});
+              position += subtree->token_count;
+              ++stats.reused_nodes;
+              stats.reused_tokens += subtree->token_count;
+              consume_subtree();
+              continue;
+            }
+
+            // The parse may have to reduce before it reaches that state
+            const std::string& action = table.get_row(state)[col];
+            if(is_reduce_action(action)) {
+              reduce(stack, get_action_number(action));
+            }
+            else {
+              break_down();
+            }
+            continue;
+          }
+
+          const std::string& action = table.get_row(state)[col];
+          if(is_shift_action(action)) {
+            SyntaxNode* node = subtree;
+            if(subtree && subtree->pre_state == state) {
+              ++stats.reused_nodes;
+              ++stats.reused_tokens;
+            }
+            else {
+              node = new SyntaxNode(col, -1, state, 1);
+              ++stats.built_nodes;
+            }
+            if(subtree) {
+              consume_subtree();
+            }
+
+            stack.push_back({get_action_number(action), node});
+            ++position;
+          }
+          else if(is_reduce_action(action)) {
+            reduce(stack, get_action_number(action));
+          }
+          else if(is_accept_action(action)) {
+            return stack.back().node;
+          }
+          else {
+            throw ParseError(position, table.get_columns()[col]);
+          }
+        }
+      }
+      catch(...) {
+        // Free the nodes this parse built, which are held by nothing
+        for(const StackEntry& entry : stack) {
+          if(entry.node && entry.node->refs == 0) {
+            ++entry.node->refs;
+            release(entry.node);
+          }
+        }
+        throw;
+      }
+    }
+
+    /**
+     * Returns the next subtree of the old tree the parse may shift at
+     * new token position, breaking down the subtrees that cover a changed
+     * token, or null if the token there is new
+     */
+    SyntaxNode* next_subtree(size_t position) {
+      const bool in_suffix = position >= new_suffix_start;
+      if(position >= prefix_end && !in_suffix) {
+        return nullptr;
+      }
+
+      const size_t old_at = in_suffix ? position - new_suffix_start + old_suffix_start : position;
+      while(!old_nodes.empty()) {
+        SyntaxNode* node = old_nodes.back();
+        if(old_position < old_at) {
+          if(old_position + node->token_count <= old_at) {
+            // Replaced or already parsed
+            consume_subtree();
+          }
+          else {
+            break_down();
+          }
+          continue;
+        }
+
+        if(node->is_token() || is_reusable(node)) {
+          return node;
+        }
+        break_down();
+      }
+
+      return nullptr;
+    }
+
+    // Returns true if the old node at old_position covers no changed
+    // token, and the token after it is unchanged
+    bool is_reusable(const SyntaxNode* node) const {
+      const size_t lookahead = old_position + node->token_count;
+      const bool unchanged = prefix_end == old_suffix_start && prefix_end == new_suffix_start;
+      return unchanged || lookahead < prefix_end || old_position >= old_suffix_start;
+    }
+
+    // Moves past the next old subtree
+    void consume_subtree() {
+      old_position += old_nodes.back()->token_count;
+      old_nodes.pop_back();
+    }
+
+    // Replaces the next old subtree with its children
+    void break_down() {
+      SyntaxNode* node = old_nodes.back();
+      old_nodes.pop_back();
+      old_nodes.insert(old_nodes.end(), node->children.rbegin(), node->children.rend());
+    }
+
+    void reduce(std::vector<StackEntry>& stack, int production) {
+      const size_t rhs_size = rhs_sizes[production];
+      const int pre_state = stack[stack.size() - rhs_size - 1].state;
+
+      SyntaxNode* node = new SyntaxNode(lhs_cols[production], production, pre_state, 0);
+      node->children.reserve(rhs_size);
+      for(size_t i = stack.size() - rhs_size; i < stack.size(); ++i) {
+        SyntaxNode* child = stack[i].node;
+        ++child->refs;
+        node->token_count += child->token_count;
+        node->children.push_back(child);
+      }
+      ++stats.built_nodes;
+
+      stack.resize(stack.size() - rhs_size);
+      stack.push_back({get_goto(pre_state, lhs_cols[production]), node});
+    }
+
+    int get_goto(int state, int col) const {
+      const std::string& goto_action = table.get_row(state)[col];
+      if(!is_goto_action(goto_action)) {
+        throw std::runtime_error("no goto on column " + std::to_string(col) + " in state " + std::to_string(state));
+      }
+
+      return get_action_number(goto_action);
+    }
+
+    // Drops a hold on node, freeing it and its children that nothing else holds
+    static void release(SyntaxNode* node) {
+      std::vector<SyntaxNode*> pending = {node};
+      while(!pending.empty()) {
+        SyntaxNode* top = pending.back();
+        pending.pop_back();
+        if(--top->refs > 0) {
+          continue;
+        }
+
+        pending.insert(pending.end(), top->children.begin(), top->children.end());
+        delete top;
+      }
+    }
+};
+
+#endif /* _INCREMENTAL_PARSER_HPP_ */
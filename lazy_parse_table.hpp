@@ -0,0 +1,118 @@
+#ifndef _LAZY_PARSE_TABLE_HPP_
+#define _LAZY_PARSE_TABLE_HPP_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "grammar.hpp"
+#include "parse_table_generator.hpp"
+
+/**
+ * A parse table whose rows are built the first time they are read
+ *
+ * Only I0 exists up front. Reading the row of a state finds its
+ * gotos, which adds the states they lead to, and fills in its
+ * actions. A parser driving the table only pays for the states its
+ * inputs actually reach, so a huge grammar is ready to parse at once.
+ *
+ * Rows are appended and never change once built, so a row can be
+ * read without a lock after it is returned. Building a row takes an
+ * exclusive lock, reading a finished one only a shared lock, so the
+ * table can be shared by parsers on several threads.
+ *
+ * States are numbered in the order they are reached, so the numbers
+ * differ from a table built by build_parse_table.
+ */
+class LazyParseTable {
+  public:
+    LazyParseTable(std::shared_ptr<const Grammar> grammar) : generator(std::move(grammar)) {
+      generator.begin_rows();
+
+      cols = generator.get_table_columns();
+      for(int i = 0; i < cols.size(); ++i) {
+        col_indices.emplace(cols[i], i);
+      }
+    }
+
+    LazyParseTable(const LazyParseTable&) = delete;
+    LazyParseTable& operator=(const LazyParseTable&) = delete;
+
+    /**
+     * Returns the actions and gotos of state, building the row
+     * if it is the first time it has been asked for
+     *
+     * Throws std::out_of_range if state hasn't been reached by a goto yet
+     */
+    const std::vector<std::string>& get_row(int state) const {
+      {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if(state >= 0 && state < rows.size() && rows[state].built) {
+          return rows[state].actions;
+        }
+      }
+
+      std::unique_lock<std::shared_mutex> lock(mutex);
+      if(state < 0 || state >= generator.get_state_count()) {
+        throw std::out_of_range("state " + std::to_string(state) + " has not been reached");
+      }
+
+      // Appending to a deque keeps references to the other rows valid
+      if(state >= rows.size()) {
+        rows.resize(state + 1);
+      }
+
+      LazyRow& row = rows[state];
+      if(!row.built) {
+        generator.build_row(state, row.actions);
+        row.built = true;
+        ++built_count;
+      }
+
+      return row.actions;
+    }
+
+    // Returns the column of symbol or -1 if it is not in the table
+    int get_column(const std::string& symbol) const {
+      const auto found = col_indices.find(symbol);
+      return found != col_indices.end() ? found->second : -1;
+    }
+
+    const std::vector<std::string>& get_columns() const {
+      return cols;
+    }
+
+    // Returns the number of rows built so far
+    size_t get_built_count() const {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      return built_count;
+    }
+
+    // Returns the number of states reached so far, built or not
+    size_t get_state_count() const {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      return generator.get_state_count();
+    }
+
+  private:
+    struct LazyRow {
+      std::vector<std::string> actions;
+      bool built = false;
+    };
+
+    // Builds the rows, guarded by mutex
+    mutable LR1ParserTableGenerator generator;
+    mutable std::deque<LazyRow> rows;
+    mutable size_t built_count = 0;
+    mutable std::shared_mutex mutex;
+
+    std::vector<std::string> cols;
+    std::unordered_map<std::string, int> col_indices;
+};
+
+#endif /* _LAZY_PARSE_TABLE_HPP_ */
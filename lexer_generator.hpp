@@ -0,0 +1,814 @@
+#ifndef _LEXER_GENERATOR_HPP_
+#define _LEXER_GENERATOR_HPP_
+
+#include <errno.h>
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "grammar.hpp"
+#include "grammar_loader.hpp"
+#include "parse_table_generator.hpp"
+#include "scanner.hpp"
+#include "table_writer.hpp"
+
+// Names a definition for text the lexer skips instead of a terminal
+const static std::string SKIP_DEFINITION = "%skip";
+
+/**
+ * The text matched by a terminal
+ *
+ * pattern is a regular expression, see LexerGenerator for the syntax.
+ * A terminal without a definition matches its own text, so '{{if'
+ * matches {{if
+ */
+struct TokenDefinition {
+  // A terminal like 'ID' or SKIP_DEFINITION
+  std::string terminal;
+  std::string pattern;
+};
+
+/**
+ * Reads a lexer definition file
+ *
+ * Each line holds a terminal and the pattern it matches, which runs to
+ * the end of the line. %skip defines text to skip between tokens.
+ * Blank lines and lines starting with # are skipped.
+ *
+ *  'ID'      [A-Za-z_][A-Za-z0-9_]*
+ *  'NUM'     [0-9]+
+ *  'STRING'  "([^"\\]|\\.)*"
+ *  %skip     [ \t\r\n]+
+ *
+ * Throws GrammarLoadError if the file can't be read or a line is malformed
+ */
+std::vector<TokenDefinition> load_lexer_definitions(const std::string& path) {
+  std::ifstream in_stream(path);
+  if(!in_stream) {
+    throw GrammarLoadError(path, 0, 0, strerror(errno));
+  }
+
+  std::vector<TokenDefinition> definitions;
+  std::string line;
+  int line_num = 0;
+  while(std::getline(in_stream, line)) {
+    ++line_num;
+
+    size_t start = line.find_first_not_of(" \t\r");
+    if(start == std::string::npos || line[start] == COMMENT_CHAR) {
+      continue;
+    }
+
+    size_t end = line.find_first_of(" \t", start);
+    TokenDefinition definition;
+    definition.terminal = line.substr(start, end - start);
+    if(!is_terminal(definition.terminal) && definition.terminal != SKIP_DEFINITION) {
+      throw GrammarLoadError(path, line_num, start + 1, "expected a terminal or " + SKIP_DEFINITION + ", found " + definition.terminal);
+    }
+
+    size_t pattern_start = end == std::string::npos ? std::string::npos : line.find_first_not_of(" \t", end);
+    size_t pattern_end = line.find_last_not_of(" \t\r");
+    if(pattern_start == std::string::npos || pattern_end < pattern_start) {
+      throw GrammarLoadError(path, line_num, line.size() + 1, "expected a pattern after " + definition.terminal);
+    }
+    definition.pattern = line.substr(pattern_start, pattern_end - pattern_start + 1);
+
+    definitions.push_back(definition);
+  }
+
+  return definitions;
+}
+
+/**
+ * Generates a minimized DFA that splits text into the terminals of
+ * a grammar
+ *
+ * Patterns support a subset of the usual regular expression syntax
+ *
+ *  a          the byte a
+ *  \n \t \r   newline, tab and carriage return, any other byte after \ is itself
+ *  \d \w \s   digits, word bytes and whitespace
+ *  .          any byte but newline
+ *  [a-z_]     any of the bytes in the class, [^...] any byte not in it
+ *  (r)        grouping
+ *  rs  r|s    concatenation and alternation
+ *  r* r+ r?   repetition
+ *
+ * 1. Each definition is compiled to an NFA (Dragon book 3.7.4) and the
+ *    NFAs share a start state. Terminals without a definition match
+ *    their own text and come first, so keywords win over patterns like 'ID'.
+ * 2. Bytes that no pattern tells apart are merged into byte classes.
+ * 3. The NFA is made a DFA by the subset construction (Dragon book 3.7.1),
+ *    moving on byte classes. A DFA state accepts the first definition
+ *    among its NFA states.
+ * 4. The DFA is minimized by partition refinement (Dragon book 3.9.6),
+ *    and the dead state is dropped.
+ *
+ * Token ids are indices into cols, the columns of the parse table,
+ * so the ids the scanner returns can be used as table columns directly.
+ */
+class LexerGenerator {
+  public:
+    LexerGenerator(const std::vector<std::string>& cols, const std::vector<TokenDefinition>& definitions) {
+      std::unordered_map<std::string, int> token_ids;
+      for(int i = 0; i < cols.size(); ++i) {
+        if(cols[i] == DOLLAR) {
+          end_token = i;
+        }
+        else if(is_terminal(cols[i])) {
+          token_ids.emplace(cols[i], i);
+        }
+      }
+      token_names.assign(cols.begin(), cols.begin() + std::min<size_t>(end_token + 1, cols.size()));
+
+      std::unordered_map<std::string, const TokenDefinition*> defined;
+      for(const TokenDefinition& definition : definitions) {
+        if(definition.terminal == SKIP_DEFINITION) {
+          continue;
+        }
+        if(token_ids.count(definition.terminal) == 0) {
+          throw std::runtime_error(definition.terminal + " is not a terminal of the grammar");
+        }
+        if(!defined.emplace(definition.terminal, &definition).second) {
+          throw std::runtime_error(definition.terminal + " is defined more than once");
+        }
+      }
+
+      // Literal terminals first, in column order
+      for(int i = 0; i < cols.size(); ++i) {
+        if(token_ids.count(cols[i]) > 0 && defined.count(cols[i]) == 0) {
+          rules.push_back({cols[i], i, cols[i].substr(1, cols[i].size() - 2), true});
+        }
+      }
+
+      for(const TokenDefinition& definition : definitions) {
+        bool skip = definition.terminal == SKIP_DEFINITION;
+        rules.push_back({definition.terminal, skip ? SKIP_TOKEN : token_ids.at(definition.terminal), definition.pattern, false});
+      }
+    }
+
+    /**
+     * Builds the DFA
+     * Throws std::runtime_error if a pattern is malformed or matches
+     * the empty string
+     */
+    LexerTables build() {
+      nfa.clear();
+      byte_sets.clear();
+
+      // 1. Build an NFA for each rule off one start state
+      const int start = add_nfa_state();
+      for(int i = 0; i < rules.size(); ++i) {
+        Fragment fragment = rules[i].literal ? compile_literal(rules[i].text) : compile_pattern(rules[i]);
+        nfa[start].epsilons.push_back(fragment.start);
+        nfa[fragment.end].rule = i;
+      }
+
+      // 2. Byte classes
+      LexerTables tables;
+      tables.token_names = token_names;
+      tables.end_token = end_token;
+      std::vector<int> class_bytes = build_byte_classes(tables);
+
+      // 3. Subset construction
+      std::vector<int> transitions;
+      std::vector<int> accepts;
+      build_dfa(start, class_bytes, transitions, accepts);
+
+      // 4. Minimize
+      minimize(tables, transitions, accepts);
+      return tables;
+    }
+
+    /**
+     * Renumbers the tokens of tables to the columns of a parse table
+     * whose columns were merged by compress_columns, so the scanner
+     * gives the parser its column classes with no lookup
+     *
+     * cols are the table columns, each a class of symbols
+     * Throws std::runtime_error, leaving tables as they were, if a token
+     * has no column, i.e. the table is for another grammar
+     */
+    static void map_tokens(LexerTables& tables, const std::vector<std::string>& cols) {
+      std::unordered_map<std::string, int> classes;
+      for(int i = 0; i < cols.size(); ++i) {
+        for(const std::string& symbol : get_column_symbols(cols[i])) {
+          classes.emplace(symbol, i);
+        }
+      }
+
+      for(const std::string& name : tables.token_names) {
+        if(classes.count(name) == 0) {
+          throw std::runtime_error("the parse table has no column for " + name);
+        }
+      }
+
+      for(int& token : tables.accepts) {
+        if(token >= 0) {
+          token = classes.at(tables.token_names[token]);
+        }
+      }
+
+      tables.end_token = classes.at(DOLLAR);
+      tables.token_names.assign(cols.begin(), cols.begin() + tables.end_token + 1);
+    }
+
+    /**
+     * Writes tables to path
+     *
+     * The first line is the token names in id order, the same as the
+     * terminal columns of the parse table. It is followed by a line with
+     * the class of each byte, a line with the token each state accepts,
+     * and then one line per state with its move on each class.
+     * Returns false if path could not be written
+     */
+    static bool write_table(const std::string& path, const LexerTables& tables) {
+      TableWriter writer(path);
+      if(!writer.is_open()) {
+        return false;
+      }
+
+      writer.write_header(tables.token_names);
+      writer.write_row(to_strings(tables.byte_classes.begin(), tables.byte_classes.end()));
+      writer.write_row(to_strings(tables.accepts.begin(), tables.accepts.end()));
+      for(int state = 0; state < tables.state_count(); ++state) {
+        auto row = tables.transitions.begin() + state * tables.class_count;
+        writer.write_row(to_strings(row, row + tables.class_count));
+      }
+
+      return writer.close();
+    }
+
+    /**
+     * Writes tables as C++ source for a standalone scanner
+     *
+     * The source declares the tables as arrays in namespace name_space
+     * along with a next_token function that works like
+     * Scanner::next_token
+     */
+    static void write_code(std::ostream& out, const LexerTables& tables, const std::string& name_space) {
+      const int state_count = tables.state_count();
+
+      out << "// Generated by set_generator\n";
+      out << "// Token ids are the columns of the terminals in the parse table\n";
+      out << "#include <cstddef>\n\n";
+      out << "namespace " << name_space << " {\n\n";
+      out << "const int TOKEN_COUNT = " << tables.token_names.size() << ";\n";
+      out << "const int END_TOKEN = " << tables.end_token << ";\n";
+      out << "const int NO_TOKEN = " << NO_TOKEN << ";\n";
+      out << "const int SKIP_TOKEN = " << SKIP_TOKEN << ";\n";
+      out << "const int STATE_COUNT = " << state_count << ";\n";
+      out << "const int CLASS_COUNT = " << tables.class_count << ";\n\n";
+
+      out << "const char* const TOKEN_NAMES[TOKEN_COUNT] = {";
+      for(int i = 0; i < tables.token_names.size(); ++i) {
+        out << (i > 0 ? ", " : "") << '"';
+        for(char c : tables.token_names[i]) {
+          if(c == '"' || c == '\\') {
+            out << '\\';
+          }
+          out << c;
+        }
+        out << '"';
+      }
+      out << "};\n\n";
+
+      out << "const int BYTE_CLASSES[256] = {";
+      write_array(out, tables.byte_classes.begin(), tables.byte_classes.end(), 16);
+      out << "};\n\n";
+
+      out << "const int ACCEPTS[STATE_COUNT] = {";
+      write_array(out, tables.accepts.begin(), tables.accepts.end(), 16);
+      out << "};\n\n";
+
+      out << "const int TRANSITIONS[STATE_COUNT][CLASS_COUNT] = {\n";
+      for(int state = 0; state < state_count; ++state) {
+        auto row = tables.transitions.begin() + state * tables.class_count;
+        out << "  {";
+        write_array(out, row, row + tables.class_count, 0);
+        out << "},\n";
+      }
+      out << "};\n\n";
+
+      out << "// Finds the longest token starting at data[position] and sets length to its size\n";
+      out << "// Returns its token id, SKIP_TOKEN for skipped text or NO_TOKEN if nothing matches\n";
+      out << "inline int next_token(const char* data, size_t size, size_t position, size_t& length) {\n";
+      out << "  int token = NO_TOKEN;\n";
+      out << "  length = 0;\n";
+      out << "  int state = 0;\n";
+      out << "  for(size_t i = position; i < size; ++i) {\n";
+      out << "    state = TRANSITIONS[state][BYTE_CLASSES[(unsigned char)data[i]]];\n";
+      out << "    if(state < 0) {\n";
+      out << "      break;\n";
+      out << "    }\n";
+      out << "    if(ACCEPTS[state] != NO_TOKEN) {\n";
+      out << "      token = ACCEPTS[state];\n";
+      out << "      length = i + 1 - position;\n";
+      out << "    }\n";
+      out << "  }\n";
+      out << "  return token;\n";
+      out << "}\n\n";
+      out << "} // namespace " << name_space << "\n";
+    }
+
+  private:
+    // A terminal and the text it matches
+    struct Rule {
+      std::string terminal;
+
+      // Token id or SKIP_TOKEN
+      int token;
+
+      // The literal text or the pattern
+      std::string text;
+      bool literal;
+    };
+
+    struct NFAState {
+      // Moves on any byte in byte_sets[first] to second
+      std::vector<std::pair<int, int>> edges;
+      std::vector<int> epsilons;
+
+      // The rule accepted here, or -1
+      int rule = -1;
+    };
+
+    // Part of the NFA with a single entry and exit
+    struct Fragment {
+      int start;
+      int end;
+    };
+
+    std::vector<Rule> rules;
+    std::vector<std::string> token_names;
+    int end_token = NO_TOKEN;
+
+    std::vector<NFAState> nfa;
+    std::vector<std::bitset<256>> byte_sets;
+
+    // Position in the pattern being compiled
+    const Rule* rule = nullptr;
+    size_t pos = 0;
+
+    int add_nfa_state() {
+      nfa.emplace_back();
+      return nfa.size() - 1;
+    }
+
+    Fragment add_byte_set(const std::bitset<256>& bytes) {
+      Fragment fragment = {add_nfa_state(), add_nfa_state()};
+      byte_sets.push_back(bytes);
+      nfa[fragment.start].edges.push_back({(int)byte_sets.size() - 1, fragment.end});
+      return fragment;
+    }
+
+    // Joins a to b so b follows a
+    Fragment concatenate(const Fragment& a, const Fragment& b) {
+      nfa[a.end].epsilons.push_back(b.start);
+      return {a.start, b.end};
+    }
+
+    Fragment compile_literal(const std::string& text) {
+      Fragment fragment = {add_nfa_state(), -1};
+      fragment.end = fragment.start;
+      for(char c : text) {
+        std::bitset<256> bytes;
+        bytes.set((unsigned char)c);
+        fragment = concatenate(fragment, add_byte_set(bytes));
+      }
+
+      return fragment;
+    }
+
+    Fragment compile_pattern(const Rule& pattern_rule) {
+      rule = &pattern_rule;
+      pos = 0;
+
+      Fragment fragment = parse_alternation();
+      if(pos < rule->text.size()) {
+        throw pattern_error("unexpected " + std::string(1, rule->text[pos]));
+      }
+
+      return fragment;
+    }
+
+    std::runtime_error pattern_error(const std::string& message) const {
+      return std::runtime_error("pattern for " + rule->terminal + " at column " + std::to_string(pos + 1) + ": " + message);
+    }
+
+    // alternation := concatenation ('|' concatenation)*
+    Fragment parse_alternation() {
+      Fragment fragment = parse_concatenation();
+      while(pos < rule->text.size() && rule->text[pos] == '|') {
+        ++pos;
+        Fragment other = parse_concatenation();
+
+        Fragment either = {add_nfa_state(), add_nfa_state()};
+        nfa[either.start].epsilons = {fragment.start, other.start};
+        nfa[fragment.end].epsilons.push_back(either.end);
+        nfa[other.end].epsilons.push_back(either.end);
+        fragment = either;
+      }
+
+      return fragment;
+    }
+
+    // concatenation := repetition*
+    Fragment parse_concatenation() {
+      Fragment fragment = {add_nfa_state(), -1};
+      fragment.end = fragment.start;
+      while(pos < rule->text.size() && rule->text[pos] != '|' && rule->text[pos] != ')') {
+        fragment = concatenate(fragment, parse_repetition());
+      }
+
+      return fragment;
+    }
+
+    // repetition := atom ('*' | '+' | '?')*
+    Fragment parse_repetition() {
+      Fragment fragment = parse_atom();
+      while(pos < rule->text.size() && (rule->text[pos] == '*' || rule->text[pos] == '+' || rule->text[pos] == '?')) {
+        const char op = rule->text[pos++];
+
+        Fragment repeated = {add_nfa_state(), add_nfa_state()};
+        nfa[repeated.start].epsilons.push_back(fragment.start);
+        nfa[fragment.end].epsilons.push_back(repeated.end);
+        if(op != '+') {
+          nfa[repeated.start].epsilons.push_back(repeated.end);
+        }
+        if(op != '?') {
+          nfa[fragment.end].epsilons.push_back(fragment.start);
+        }
+        fragment = repeated;
+      }
+
+      return fragment;
+    }
+
+    // atom := '(' alternation ')' | '[' class ']' | '.' | '\' byte | byte
+    Fragment parse_atom() {
+      const std::string& text = rule->text;
+      const char c = text[pos++];
+
+      if(c == '(') {
+        Fragment fragment = parse_alternation();
+        if(pos >= text.size() || text[pos] != ')') {
+          throw pattern_error("expected )");
+        }
+        ++pos;
+        return fragment;
+      }
+
+      if(c == '*' || c == '+' || c == '?') {
+        --pos;
+        throw pattern_error(std::string(1, c) + " must follow something to repeat");
+      }
+
+      std::bitset<256> bytes;
+      if(c == '[') {
+        bytes = parse_class();
+      }
+      else if(c == '.') {
+        bytes.set();
+        bytes.reset('\n');
+      }
+      else if(c == '\\') {
+        bytes = parse_escape();
+      }
+      else {
+        bytes.set((unsigned char)c);
+      }
+
+      return add_byte_set(bytes);
+    }
+
+    // Reads the byte or shorthand class after a \ at pos
+    std::bitset<256> parse_escape() {
+      if(pos >= rule->text.size()) {
+        throw pattern_error("expected a byte after \\");
+      }
+
+      std::bitset<256> bytes;
+      const char c = rule->text[pos++];
+      switch(c) {
+        case 'n': bytes.set('\n'); break;
+        case 't': bytes.set('\t'); break;
+        case 'r': bytes.set('\r'); break;
+        case 'd':
+          for(int b = '0'; b <= '9'; ++b) {
+            bytes.set(b);
+          }
+          break;
+        case 'w':
+          for(int b = 0; b < 256; ++b) {
+            if(std::isalnum(b) || b == '_') {
+              bytes.set(b);
+            }
+          }
+          break;
+        case 's':
+          for(char b : std::string(" \t\r\n\f\v")) {
+            bytes.set((unsigned char)b);
+          }
+          break;
+        default: bytes.set((unsigned char)c); break;
+      }
+
+      return bytes;
+    }
+
+    // Reads a class like a-z_] after its [
+    std::bitset<256> parse_class() {
+      const std::string& text = rule->text;
+
+      bool negated = pos < text.size() && text[pos] == '^';
+      if(negated) {
+        ++pos;
+      }
+
+      std::bitset<256> bytes;
+      bool first = true;
+      while(pos < text.size() && (text[pos] != ']' || first)) {
+        first = false;
+
+        std::bitset<256> from;
+        if(text[pos] == '\\') {
+          ++pos;
+          from = parse_escape();
+        }
+        else {
+          from.set((unsigned char)text[pos++]);
+        }
+
+        // A range like a-z, unless the - ends the class
+        if(from.count() == 1 && pos + 1 < text.size() && text[pos] == '-' && text[pos+1] != ']') {
+          ++pos;
+          int low = 0;
+          while(!from.test(low)) {
+            ++low;
+          }
+
+          int high = (unsigned char)text[pos++];
+          if(text[pos-1] == '\\') {
+            std::bitset<256> to = parse_escape();
+            high = 0;
+            while(!to.test(high)) {
+              ++high;
+            }
+          }
+          if(high < low) {
+            throw pattern_error("range is out of order");
+          }
+
+          for(int b = low; b <= high; ++b) {
+            bytes.set(b);
+          }
+        }
+        else {
+          bytes |= from;
+        }
+      }
+
+      if(pos >= text.size()) {
+        throw pattern_error("expected ]");
+      }
+      ++pos;
+
+      return negated ? ~bytes : bytes;
+    }
+
+    /**
+     * Gives each byte a class so that two bytes share a class if every
+     * byte set in the NFA either has both or neither
+     * Returns a byte of each class
+     */
+    std::vector<int> build_byte_classes(LexerTables& tables) {
+      std::map<std::vector<bool>, int> class_ids;
+      std::vector<int> class_bytes;
+      for(int b = 0; b < 256; ++b) {
+        std::vector<bool> membership(byte_sets.size());
+        for(int i = 0; i < byte_sets.size(); ++i) {
+          membership[i] = byte_sets[i].test(b);
+        }
+
+        auto result = class_ids.emplace(std::move(membership), class_bytes.size());
+        if(result.second) {
+          class_bytes.push_back(b);
+        }
+        tables.byte_classes[b] = result.first->second;
+      }
+
+      tables.class_count = class_bytes.size();
+      return class_bytes;
+    }
+
+    // Adds the states reachable from states through epsilon moves to states
+    void epsilon_closure(std::vector<int>& states) const {
+      std::vector<bool> seen(nfa.size(), false);
+      std::vector<int> stack = states;
+      for(int state : states) {
+        seen[state] = true;
+      }
+
+      while(!stack.empty()) {
+        int state = stack.back();
+        stack.pop_back();
+
+        for(int next : nfa[state].epsilons) {
+          if(!seen[next]) {
+            seen[next] = true;
+            states.push_back(next);
+            stack.push_back(next);
+          }
+        }
+      }
+
+      std::sort(states.begin(), states.end());
+    }
+
+    /**
+     * Subset construction
+     * transitions[state * class_count + class] is the next DFA state or -1
+     * and accepts[state] the token it accepts
+     */
+    void build_dfa(int start, const std::vector<int>& class_bytes, std::vector<int>& transitions, std::vector<int>& accepts) {
+      const int class_count = class_bytes.size();
+
+      std::map<std::vector<int>, int> dfa_states;
+      std::vector<std::vector<int>> unmarked;
+
+      auto add_dfa_state = [&](std::vector<int> states) {
+        epsilon_closure(states);
+        auto result = dfa_states.emplace(states, accepts.size());
+        if(result.second) {
+          int best_rule = -1;
+          for(int state : states) {
+            if(nfa[state].rule >= 0 && (best_rule < 0 || nfa[state].rule < best_rule)) {
+              best_rule = nfa[state].rule;
+            }
+          }
+
+          accepts.push_back(best_rule >= 0 ? rules[best_rule].token : NO_TOKEN);
+          transitions.resize(transitions.size() + class_count, -1);
+          unmarked.push_back(std::move(states));
+        }
+        return result.first->second;
+      };
+
+      add_dfa_state({start});
+      if(accepts[0] != NO_TOKEN) {
+        for(const Rule& empty_rule : rules) {
+          if(empty_rule.token == accepts[0]) {
+            throw std::runtime_error("pattern for " + empty_rule.terminal + " matches the empty string");
+          }
+        }
+      }
+
+      for(int dfa_state = 0; dfa_state < unmarked.size(); ++dfa_state) {
+        for(int c = 0; c < class_count; ++c) {
+          std::vector<int> moves;
+          for(int state : unmarked[dfa_state]) {
+            for(const auto& edge : nfa[state].edges) {
+              if(byte_sets[edge.first].test(class_bytes[c])) {
+                moves.push_back(edge.second);
+              }
+            }
+          }
+
+          if(moves.empty()) {
+            continue;
+          }
+
+          std::sort(moves.begin(), moves.end());
+          moves.erase(std::unique(moves.begin(), moves.end()), moves.end());
+
+          int next = add_dfa_state(std::move(moves));
+          transitions[dfa_state * class_count + c] = next;
+        }
+      }
+    }
+
+    /**
+     * Merges equivalent DFA states into tables
+     *
+     * Missing moves go to an added dead state. States start out grouped
+     * by the token they accept and a group is split whenever its states
+     * move on some class into different groups, until no group splits.
+     * The group of the dead state is dropped and moves into it are
+     * missing again. The group holding state 0 stays state 0 and the
+     * others are numbered by their lowest state.
+     */
+    void minimize(LexerTables& tables, const std::vector<int>& transitions, const std::vector<int>& accepts) const {
+      const int class_count = tables.class_count;
+      const int dead = accepts.size();
+      const int state_count = dead + 1;
+
+      auto move = [&](int state, int c) {
+        if(state == dead) {
+          return dead;
+        }
+        int next = transitions[state * class_count + c];
+        return next < 0 ? dead : next;
+      };
+
+      auto accept_of = [&](int state) {
+        return state == dead ? NO_TOKEN : accepts[state];
+      };
+
+      // Group by accepted token
+      std::vector<int> block_of(state_count);
+      {
+        std::map<int, int> block_ids;
+        for(int state = 0; state < state_count; ++state) {
+          block_of[state] = block_ids.emplace(accept_of(state), block_ids.size()).first->second;
+        }
+      }
+
+      // Split until every state in a block moves to the same blocks
+      size_t block_count = 0;
+      while(true) {
+        std::map<std::vector<int>, int> signatures;
+        std::vector<int> next_block_of(state_count);
+        for(int state = 0; state < state_count; ++state) {
+          std::vector<int> signature = {block_of[state]};
+          for(int c = 0; c < class_count; ++c) {
+            signature.push_back(block_of[move(state, c)]);
+          }
+
+          next_block_of[state] = signatures.emplace(std::move(signature), signatures.size()).first->second;
+        }
+
+        block_of = std::move(next_block_of);
+        if(signatures.size() == block_count) {
+          break;
+        }
+        block_count = signatures.size();
+      }
+
+      // Number the blocks, keeping the dead block out unless state 0 is in it
+      const int dead_block = block_of[dead] != block_of[0] ? block_of[dead] : -1;
+      std::vector<int> block_state(block_count, -1);
+      std::vector<int> representative;
+      for(int state = 0; state < dead; ++state) {
+        const int block = block_of[state];
+        if(block != dead_block && block_state[block] < 0) {
+          block_state[block] = representative.size();
+          representative.push_back(state);
+        }
+      }
+
+      tables.accepts.clear();
+      tables.transitions.assign(representative.size() * class_count, -1);
+      for(int new_state = 0; new_state < representative.size(); ++new_state) {
+        const int state = representative[new_state];
+        tables.accepts.push_back(accepts[state]);
+
+        for(int c = 0; c < class_count; ++c) {
+          const int next = move(state, c);
+          if(block_of[next] != dead_block && next != dead) {
+            tables.transitions[new_state * class_count + c] = block_state[block_of[next]];
+          }
+        }
+      }
+    }
+
+    template<typename Iterator>
+    static std::vector<std::string> to_strings(Iterator begin, Iterator end) {
+      std::vector<std::string> strings;
+      for(Iterator it = begin; it != end; ++it) {
+        strings.push_back(std::to_string(*it));
+      }
+
+      return strings;
+    }
+
+    // Writes the numbers in [begin, end) separated by commas, breaking
+    // the line every per_line numbers if per_line isn't 0
+    template<typename Iterator>
+    static void write_array(std::ostream& out, Iterator begin, Iterator end, int per_line) {
+      int i = 0;
+      for(Iterator it = begin; it != end; ++it, ++i) {
+        if(per_line > 0 && i % per_line == 0) {
+          out << "\n  ";
+        }
+        else if(i > 0) {
+          out << " ";
+        }
+        out << *it << (it + 1 != end ? "," : "");
+      }
+
+      if(per_line > 0) {
+        out << "\n";
+      }
+    }
+};
+
+#endif /* _LEXER_GENERATOR_HPP_ */
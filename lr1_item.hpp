@@ -81,6 +81,18 @@ class LR1Item {
       return production_num;
     }
 
+    // Gets the lhs of the production
+    // S -> A . B returns S
+    const std::string& get_lhs() const {
+      return lhs;
+    }
+
+    // Gets the position of the marker in the rhs
+    // S -> A . B returns 1
+    int get_position() const {
+      return position;
+    }
+
     // Gets the lookahead token
     std::string get_lookahead() const {
       return lookahead;
@@ -100,9 +112,16 @@ class LR1Item {
       }
     }
 
-    // If this rule's lhs == S'
+    // If this rule's lhs is S' or the augmented symbol of another start symbol
     bool is_augmented_production() const {
-      return lhs == AUGMENTED_LHS;
+      return is_augmented_symbol(lhs);
+    }
+
+    // Kernel items are the augmented item and all items whose
+    // marker is not at the left end
+    // S' -> . S and S -> A . B are kernel items, S -> . A B is not
+    bool is_kernel_item() const {
+      return position > 0 || is_augmented_production();
     }
 
     // TODO : Deprecated. Was used for storing in unordered_set.
@@ -110,6 +129,18 @@ class LR1Item {
       return this->get_str_for_hash() == rhs.get_str_for_hash();
     }
 
+    // Estimates the bytes the item holds outside of itself,
+    // i.e. its strings and symbols on the heap
+    size_t get_heap_bytes() const {
+      size_t bytes = get_heap_bytes(lhs) + get_heap_bytes(rhs_str) + get_heap_bytes(lookahead);
+      bytes += rhs.capacity() * sizeof(std::string);
+      for(const std::string& symbol : rhs) {
+        bytes += get_heap_bytes(symbol);
+      }
+
+      return bytes;
+    }
+
     // Returns string version of this item
     // i.e S->A.B,$
     std::string to_string() const {
@@ -120,6 +151,13 @@ class LR1Item {
     }
 
   private:
+    // Short strings are stored inside the string itself
+    static size_t get_heap_bytes(const std::string& str) {
+      const char* data = str.data();
+      const bool is_local = data >= (const char*)&str && data < (const char*)(&str + 1);
+      return is_local ? 0 : str.capacity() + 1;
+    }
+
     // The number of the production of this item in the grammar
     // Useful for determining which state to reduce to when building parse table
     int production_num;
@@ -0,0 +1,413 @@
+#ifndef _LR_PARSER_HPP_
+#define _LR_PARSER_HPP_
+
+#include <errno.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "grammar.hpp"
+#include "parse_profile.hpp"
+#include "parse_table_generator.hpp"
+
+/**
+ * Thrown when the input is not a sentence of the grammar
+ * position is the index of the token that has no action,
+ * which is the number of tokens for the end of the input
+ */
+class ParseError : public std::runtime_error {
+  public:
+    ParseError(size_t position, const std::string& token) :
+      std::runtime_error("unexpected " + token + " at token " + std::to_string(position)),
+      position(position),
+      token(token) {}
+
+    size_t get_position() const {
+      return position;
+    }
+
+    const std::string& get_token() const {
+      return token;
+    }
+
+  private:
+    size_t position;
+    std::string token;
+};
+
+/**
+ * A finished parse table, as written by LR1ParserTableGenerator
+ *
+ * Never changes once built, so any number of parsers can share it
+ *
+ * A column may hold a class of symbols from compress_columns, in which
+ * case each of its symbols maps to it
+ */
+class ParseTable {
+  public:
+    ParseTable(std::vector<std::string> cols, std::vector<std::vector<std::string>> rows) :
+      cols(std::move(cols)),
+      rows(std::move(rows)) {
+      for(int i = 0; i < this->cols.size(); ++i) {
+        for(const std::string& symbol : get_column_symbols(this->cols[i])) {
+          col_indices.emplace(symbol, i);
+        }
+      }
+    }
+
+    // Moves the table generator has built out of it
+    ParseTable(LR1ParserTableGenerator& generator) :
+      ParseTable(generator.get_table_columns(), generator.release_parse_table()) {}
+
+    /**
+     * Reads a table written by TableWriter
+     *
+     * The header quotes every column, so the columns up to the one
+     * holding $ are read as terminals and the rest as non-terminals
+     * with their quotes taken off. Each row must have an entry per column,
+     * and every shift and goto must be to one of the rows.
+     *
+     * Throws std::runtime_error if path can't be read or is malformed
+     */
+    static ParseTable load(const std::string& path) {
+      std::ifstream in_stream(path);
+      if(!in_stream) {
+        throw std::runtime_error("failed to open " + path + ": " + strerror(errno));
+      }
+
+      std::string line;
+      if(!std::getline(in_stream, line)) {
+        throw std::runtime_error(path + ": missing the header");
+      }
+      std::vector<std::string> cols = read_header(line);
+      if(cols.empty()) {
+        throw std::runtime_error(path + ":1: no $ column in the header");
+      }
+
+      std::vector<std::vector<std::string>> rows;
+      int line_num = 1;
+      while(std::getline(in_stream, line)) {
+        ++line_num;
+
+        // Entries are separated by ", " and hold no commas themselves
+        std::vector<std::string> row;
+        row.reserve(cols.size());
+        size_t start = 0;
+        while(true) {
+          size_t end = line.find(',', start);
+          row.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+          if(end == std::string::npos) {
+            break;
+          }
+          start = end + 1 < line.size() && line[end + 1] == ' ' ? end + 2 : end + 1;
+        }
+
+        if(row.size() != cols.size()) {
+          throw std::runtime_error(path + ":" + std::to_string(line_num) + ": expected " + std::to_string(cols.size()) + " entries but found " + std::to_string(row.size()));
+        }
+        rows.push_back(std::move(row));
+      }
+
+      for(size_t state = 0; state < rows.size(); ++state) {
+        for(const std::string& entry : rows[state]) {
+          for(const std::string& action : get_entry_actions(entry)) {
+            const bool to_state = is_shift_action(action) || is_goto_action(action);
+            if((to_state || is_reduce_action(action)) && (!is_action_number(action) || (to_state && get_action_number(action) >= rows.size()))) {
+              throw std::runtime_error(path + ":" + std::to_string(state + 2) + ": " + action + " is not a state of the table");
+            }
+          }
+        }
+      }
+
+      return ParseTable(std::move(cols), std::move(rows));
+    }
+
+    /**
+     * Checks that every reduce is by a production of grammar and that
+     * each lhs but S' has a column, as they do if grammar is the one the
+     * table was built from
+     * Throws std::runtime_error if not
+     */
+    void check_grammar(const Grammar& grammar) const {
+      for(size_t i = 0; i < grammar.size(); ++i) {
+        const std::string& lhs = grammar.get_symbol(grammar.get_production(i).lhs);
+        if(!is_augmented_symbol(lhs) && get_column(lhs) < 0) {
+          throw std::runtime_error("the table has no column for " + lhs);
+        }
+      }
+
+      for(size_t state = 0; state < rows.size(); ++state) {
+        for(const std::string& entry : rows[state]) {
+          for(const std::string& action : get_entry_actions(entry)) {
+            if(is_reduce_action(action) && (!is_action_number(action) || get_action_number(action) >= grammar.size())) {
+              throw std::runtime_error("state " + std::to_string(state) + " reduces by " + action + ", which is not a production of the grammar");
+            }
+          }
+        }
+      }
+    }
+
+    // Returns the actions and gotos of state
+    const std::vector<std::string>& get_row(int state) const {
+      return rows.at(state);
+    }
+
+    // Returns the column of symbol or -1 if it is not in the table
+    int get_column(const std::string& symbol) const {
+      const auto found = col_indices.find(symbol);
+      return found != col_indices.end() ? found->second : -1;
+    }
+
+    const std::vector<std::string>& get_columns() const {
+      return cols;
+    }
+
+  private:
+    std::vector<std::string> cols;
+    std::vector<std::vector<std::string>> rows;
+    std::unordered_map<std::string, int> col_indices;
+
+    // Returns true if the number of a shift, reduce or goto
+    // is all digits and fits get_action_number
+    static bool is_action_number(const std::string& action) {
+      const std::string digits = action.substr(is_goto_action(action) ? 0 : 1);
+      return !digits.empty() && digits.size() < 10 && std::all_of(digits.begin(), digits.end(), [](char c) {
+        return std::isdigit((unsigned char)c);
+      });
+    }
+
+    // Returns the columns named by a header line, or none if it has no $
+    static std::vector<std::string> read_header(const std::string& line) {
+      std::vector<std::string> cols;
+      std::string col;
+      size_t pos = 0;
+
+      // Terminal columns, like 'ID' or a class like 'BOOL' 'NUM', up to the
+      // one with $. A terminal ends at the first quote after its first
+      // character that is followed by a space, a comma or the end of the line
+      bool found_dollar = false;
+      while(pos < line.size() && !found_dollar) {
+        size_t end;
+        if(line.compare(pos, DOLLAR.size() + 2, "'" + DOLLAR + "'") == 0) {
+          end = pos + DOLLAR.size() + 2;
+          col = DOLLAR;
+          found_dollar = true;
+        }
+        else if(line.compare(pos, DOLLAR.size(), DOLLAR) == 0) {
+          end = pos + DOLLAR.size();
+          col += DOLLAR;
+          found_dollar = true;
+        }
+        else {
+          end = pos + 2;
+          while(end < line.size() && !(line[end] == '\'' && (end + 1 == line.size() || line[end + 1] == ' ' || line[end + 1] == ','))) {
+            ++end;
+          }
+          if(end == line.size()) {
+            return {};
+          }
+          col += line.substr(pos, ++end - pos);
+        }
+
+        if(end < line.size() && line[end] == ' ') {
+          col += ' ';
+        }
+        else {
+          cols.push_back(std::move(col));
+          col.clear();
+        }
+        pos = end + 1;
+      }
+      if(!found_dollar) {
+        return {};
+      }
+
+      // Non-terminal columns, like 'content' or 'block blocks'
+      while(pos < line.size()) {
+        size_t end = line.find(',', pos);
+        if(end == std::string::npos) {
+          end = line.size();
+        }
+        col = line.substr(pos, end - pos);
+        if(col.size() >= 2 && col.front() == '\'' && col.back() == '\'') {
+          col = col.substr(1, col.size() - 2);
+        }
+        cols.push_back(std::move(col));
+        pos = end + 1;
+      }
+
+      return cols;
+    }
+};
+
+/**
+ * The stack and output of a parse, kept so a thread that parses many
+ * inputs only allocates them once. See LRParser::parse
+ */
+struct ParseContext {
+  std::vector<int> stack;
+  std::vector<int> reductions;
+};
+
+/**
+ * Runs the LR parsing algorithm over a table
+ *
+ * Table is anything with get_row(state) and get_column(symbol) like
+ * ParseTable or LazyParseTable. Reduce actions are read as production
+ * numbers of grammar, which must be the grammar the table was built from.
+ *
+ * The parser keeps no state between calls to parse, so one parser can
+ * be used from several threads if its table can.
+ */
+template<typename Table>
+class LRParser {
+  public:
+    LRParser(const Grammar& grammar, const Table& table) : table(table) {
+      for(size_t i = 0; i < grammar.size(); ++i) {
+        const Production& production = grammar.get_production(i);
+        lhs_cols.push_back(table.get_column(grammar.get_symbol(production.lhs)));
+        rhs_sizes.push_back(production.rhs.size());
+      }
+
+      dollar_col = table.get_column(DOLLAR);
+    }
+
+    /**
+     * Parses tokens, a sentence of terminals like 'ID' '=' 'ID'
+     * The end of the input is added and need not be in tokens
+     *
+     * start_state picks the start symbol for a grammar with several,
+     * see LR1ParserTableGenerator::get_start_state
+     *
+     * If profile is set, every cell the parse reads is recorded in it
+     *
+     * Returns the productions in the order they were reduced by,
+     * which is a rightmost derivation in reverse
+     * Throws ParseError at the first token without an action
+     */
+    std::vector<int> parse(const std::vector<std::string>& tokens, int start_state = 0, ParseProfile* profile = nullptr) const {
+      std::vector<int> token_cols;
+      token_cols.reserve(tokens.size() + 1);
+      for(size_t position = 0; position < tokens.size(); ++position) {
+        const int col = table.get_column(tokens[position]);
+        if(col < 0 || col == dollar_col) {
+          throw ParseError(position, tokens[position]);
+        }
+        token_cols.push_back(col);
+      }
+      token_cols.push_back(dollar_col);
+
+      return parse(token_cols, start_state, profile);
+    }
+
+    /**
+     * Parses tokens given as the table columns of their terminals,
+     * like the token ids from a Scanner
+     * tokens must end with the column of $
+     *
+     * Algorithm from Dragon book 4.5.3, with start_state and profile as above
+     * 1. With state s on top of the stack and a as the next token
+     * 2a. If ACTION[s, a] is shift t, push t and move past a
+     * 2b. If ACTION[s, a] is reduce A → β, pop |β| states and
+     *      push GOTO[t, A] where t is the state now on top
+     * 2c. If ACTION[s, a] is accept, the parse is done
+     * 3. Otherwise a is a syntax error
+     *
+     * Returns the productions reduced by as above
+     * Throws ParseError at the first token without an action
+     */
+    std::vector<int> parse(const std::vector<int>& tokens, int start_state = 0, ParseProfile* profile = nullptr) const {
+      ParseContext context;
+      parse(tokens, context, start_state, profile);
+      return std::move(context.reductions);
+    }
+
+    /**
+     * Same as above, with the stack and reductions kept in context,
+     * which is cleared first
+     * Returns the reductions in context
+     */
+    const std::vector<int>& parse(const std::vector<int>& tokens, ParseContext& context, int start_state = 0, ParseProfile* profile = nullptr) const {
+      std::vector<int>& reductions = context.reductions;
+      std::vector<int>& stack = context.stack;
+      reductions.clear();
+      stack.assign(1, start_state);
+
+      auto get_cell = [&](int state, int col) -> const std::string& {
+        if(profile) {
+          profile->record(state, col);
+        }
+        return table.get_row(state)[col];
+      };
+
+      if(profile) {
+        profile->begin_parse();
+      }
+
+      size_t position = 0;
+      while(position < tokens.size()) {
+        const int col = tokens[position];
+        if(col < 0 || col > dollar_col) {
+          throw ParseError(position, std::to_string(col));
+        }
+
+        const std::string& action = get_cell(stack.back(), col);
+        if(is_shift_action(action)) {
+          stack.push_back(get_action_number(action));
+          ++position;
+        }
+        else if(is_reduce_action(action)) {
+          const int production = get_action_number(action);
+          if(rhs_sizes[production] >= stack.size()) {
+            throw std::runtime_error("production " + std::to_string(production) + " pops more states than the stack has in state " + std::to_string(stack.back()));
+          }
+          stack.resize(stack.size() - rhs_sizes[production]);
+
+          const std::string& goto_action = get_cell(stack.back(), lhs_cols[production]);
+          if(!is_goto_action(goto_action)) {
+            throw std::runtime_error("no goto for production " + std::to_string(production) + " in state " + std::to_string(stack.back()));
+          }
+
+          stack.push_back(get_action_number(goto_action));
+          reductions.push_back(production);
+        }
+        else if(is_accept_action(action)) {
+          return reductions;
+        }
+        else {
+          throw ParseError(position, table.get_columns()[col]);
+        }
+      }
+
+      throw ParseError(position, DOLLAR);
+    }
+
+    // Returns true if tokens is a sentence of the grammar
+    bool accepts(const std::vector<std::string>& tokens, int start_state = 0) const {
+      try {
+        parse(tokens, start_state);
+        return true;
+      }
+      catch(const ParseError& e) {
+        return false;
+      }
+    }
+
+  private:
+    const Table& table;
+
+    // The goto column of the lhs of each production
+    std::vector<int> lhs_cols;
+
+    // The number of symbols to pop when reducing by each production
+    std::vector<size_t> rhs_sizes;
+
+    int dollar_col;
+};
+
+#endif /* _LR_PARSER_HPP_ */
@@ -1,8 +1,22 @@
 #include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <set>
+#include <memory>
 #include "parse_table_generator.hpp"
+#include "generation_cache.hpp"
+#include "grammar_loader.hpp"
+#include "table_writer.hpp"
+#include "batch_generator.hpp"
+#include "lazy_parse_table.hpp"
+#include "lexer_generator.hpp"
+#include "lr_parser.hpp"
+#include "glr_parser.hpp"
+#include "incremental_parser.hpp"
+#include "parse_service.hpp"
 
 const static std::vector<std::string> G1 {
   {"B -> C"},
@@ -133,7 +147,7 @@ const static std::vector<std::string> G3 {
   {"E -> ~"},
 };
 
-void print_first_sets(std::unordered_map<std::string, std::unordered_set<std::string>> first_sets) {
+void print_first_sets(const std::unordered_map<std::string, std::unordered_set<std::string>>& first_sets) {
   for(const auto& a : first_sets) {
     std::cout << a.first << " : " << "[";
 
@@ -151,7 +165,7 @@ void print_first_sets(std::unordered_map<std::string, std::unordered_set<std::st
   std::cout << "\n";
 }
 
-void print_item_sets(const std::set<std::set<LR1Item, LR1Comparator>, LR1SetComparator>& item_sets) {
+void print_item_sets(const std::vector<std::set<LR1Item, LR1Comparator>>& item_sets) {
   std::cout << "Item Sets: \n";
   int set_num = 0;
 
@@ -215,77 +229,934 @@ void print_go_parse_table(const std::vector<std::vector<std::string>>& parse_tab
 }
 
 int write_table(const std::string out_path, const std::vector<std::vector<std::string>>& parse_table, const std::vector<std::string>& symbols) {
-  std::ofstream out_stream(out_path);
+  TableWriter writer(out_path);
+
+  if(!writer.is_open()) {
+    std::cerr << "failed to open output stream " << out_path << ": " << writer.get_error() << "\n";
+    return 1;
+  }
+
+  writer.write_header(symbols);
+  for(const auto& row : parse_table) {
+    writer.write_row(row);
+  }
+
+  if(!writer.close()) {
+    std::cerr << "failed to write " << out_path << ": " << writer.get_error() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
+
+// Prints what was pruned from a grammar
+void print_grammar_reduction(const GrammarReduction& reduction) {
+  if(reduction.empty()) {
+    std::cout << "grammar has no useless productions\n";
+    return;
+  }
+
+  std::cout << "removed " << reduction.removed_productions.size() << " useless productions:\n";
+  for(const std::string& production : reduction.removed_productions) {
+    std::cout << "  " << production << "\n";
+  }
+
+  if(!reduction.unproductive_symbols.empty()) {
+    std::cout << "unproductive symbols:";
+    for(const std::string& symbol : reduction.unproductive_symbols) {
+      std::cout << " " << symbol;
+    }
+    std::cout << "\n";
+  }
+
+  if(!reduction.unreachable_symbols.empty()) {
+    std::cout << "unreachable symbols:";
+    for(const std::string& symbol : reduction.unreachable_symbols) {
+      std::cout << " " << symbol;
+    }
+    std::cout << "\n";
+  }
+}
+
+// Writes each of conflicts to the file at path, one per line
+// Returns 0 on success
+int write_conflict_report(const std::string& path, const std::vector<Conflict>& conflicts, const Grammar& grammar) {
+  std::ofstream out_stream(path);
+  for(const Conflict& conflict : conflicts) {
+    out_stream << conflict.to_string(grammar) << "\n";
+  }
 
   if(!out_stream) {
-    std::cerr << "failed to open output stream " << out_path << ": " << strerror(errno) << "\n";
+    std::cerr << "failed to write " << path << ": " << strerror(errno) << "\n";
     return 1;
   }
+  return 0;
+}
 
-  // write the symbol header
-  for(int i = 0; i < symbols.size(); ++i) {
-    std::string symbol = symbols[i];
+// Warns about conflicts the precedence declarations did not resolve
+void print_conflicts(const ConflictCounts& conflicts) {
+  if(conflicts.shift_reduce > 0) {
+    std::cerr << "warning: " << conflicts.shift_reduce << " shift/reduce conflicts, resolved by shifting\n";
+  }
+  if(conflicts.reduce_reduce > 0) {
+    std::cerr << "warning: " << conflicts.reduce_reduce << " reduce/reduce conflicts, resolved by the earlier production\n";
+  }
+}
+
+// Generates the lexer for the terminals of grammar from the definitions
+// in the file at definitions_path into lexer
+// Returns 0 on success
+int generate_lexer(const std::shared_ptr<const Grammar>& grammar, const std::string& definitions_path, LexerTables& lexer) {
+  std::cout << "generating lexer\n";
+  try {
+    LR1ParserTableGenerator generator(grammar);
+    LexerGenerator lexer_generator(generator.get_table_columns(), load_lexer_definitions(definitions_path));
+    lexer = lexer_generator.build();
+  }
+  catch(const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  std::cout << "lexer has " << lexer.state_count() << " states and " << lexer.class_count << " byte classes\n";
+  return 0;
+}
 
-    if(symbol.size() > 0 && symbol[0] != '\'' && symbol[symbol.size()-1] != '\'') {
-      symbol = ('\'' + symbol + '\'');
+// Writes the lexer table and code files that have a path
+// Returns 0 on success
+int write_lexer(const LexerTables& lexer, const std::string& table_path, const std::string& code_path) {
+  if(!table_path.empty() && !LexerGenerator::write_table(table_path, lexer)) {
+    std::cerr << "failed to write " << table_path << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+
+  if(!code_path.empty()) {
+    std::ofstream out_stream(code_path);
+    LexerGenerator::write_code(out_stream, lexer, "lexer");
+    if(!out_stream) {
+      std::cerr << "failed to write " << code_path << ": " << strerror(errno) << "\n";
+      return 1;
     }
-    out_stream << symbol;
+  }
 
-    if(i < symbols.size() - 1) {
-      out_stream << ",";
+  return 0;
+}
+
+// Reads the tokens of the file at tokens_path and parses them with parse
+// Without a lexer the file holds whitespace separated terminals,
+// with one it is source text for the lexer
+// parse takes the tokens as terminals or as token ids and returns what
+// to print after the number of tokens it accepted
+// Returns 0 if it is a sentence of grammar
+template<typename Parse>
+int parse_file(const std::string& tokens_path, const LexerTables* lexer, Parse parse) {
+  std::ifstream in_stream(tokens_path);
+  if(!in_stream) {
+    std::cerr << "failed to open " << tokens_path << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+
+  try {
+    std::string result;
+    size_t token_count;
+    if(lexer) {
+      std::string source((std::istreambuf_iterator<char>(in_stream)), std::istreambuf_iterator<char>());
+      std::vector<int> tokens = Scanner(*lexer).tokenize(source);
+      result = parse(tokens);
+      token_count = tokens.size() - 1;
+    }
+    else {
+      std::vector<std::string> tokens;
+      std::string token;
+      while(in_stream >> token) {
+        tokens.push_back(token);
+      }
+      result = parse(tokens);
+      token_count = tokens.size();
     }
+
+    std::cout << "accepted " << token_count << " tokens " << result << "\n";
+  }
+  catch(const ParseError& e) {
+    std::cerr << tokens_path << ": " << e.what() << "\n";
+    return 1;
+  }
+  catch(const ScanError& e) {
+    std::cerr << tokens_path << ": " << e.what() << "\n";
+    return 1;
   }
 
-  out_stream << "\n";
+  return 0;
+}
 
-  for(int i = 0; i < parse_table.size(); ++i) {
-    int row_size = parse_table[i].size();
-    for(int j = 0; j < row_size; ++j) {
-      const std::string& action = parse_table[i][j];
-      out_stream << action;
+// Parses the file at tokens_path with parser, see parse_file above
+// If profile is set, the cells the parse reads are recorded in it
+template<typename Table>
+int parse_file(const LRParser<Table>& parser, const std::string& tokens_path, const LexerTables* lexer, ParseProfile* profile = nullptr) {
+  return parse_file(tokens_path, lexer, [&](const auto& tokens) {
+    return "with " + std::to_string(parser.parse(tokens, 0, profile).size()) + " reductions";
+  });
+}
 
-      if(j < row_size - 1) {
-        out_stream << ", ";
+// Parses the file at tokens_path with a lazily built table
+// Returns 0 if it is a sentence of grammar
+int parse_tokens(const std::shared_ptr<const Grammar>& grammar, const std::string& tokens_path, const LexerTables* lexer) {
+  LazyParseTable table(grammar);
+  LRParser<LazyParseTable> parser(*grammar, table);
+
+  int result = parse_file(parser, tokens_path, lexer);
+  std::cout << "built " << table.get_built_count() << " rows of " << table.get_state_count() << " states reached\n";
+  return result;
+}
+
+// Parses the source text in the file at tokens_path with IncrementalParser
+// over a lazily built table, then makes each edit in the file at edits_path
+// and reparses, printing how much of the tree was reused
+// Each line of the edits file is an edit like 120 3 {{: x}}, which replaces
+// 3 bytes at byte 120 with the rest of the line after one space, in which
+// \n, \t and \\ are escapes
+// Returns 0 if the text parsed after every edit
+int parse_edits(const std::shared_ptr<const Grammar>& grammar, const std::string& tokens_path, const LexerTables& lexer, const std::string& edits_path) {
+  std::ifstream in_stream(tokens_path);
+  if(!in_stream) {
+    std::cerr << "failed to open " << tokens_path << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+  std::ifstream edits_stream(edits_path);
+  if(!edits_stream) {
+    std::cerr << "failed to open " << edits_path << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+
+  LazyParseTable table(grammar);
+  IncrementalParser<LazyParseTable> parser(*grammar, table, lexer);
+  try {
+    parser.set_text(std::string((std::istreambuf_iterator<char>(in_stream)), std::istreambuf_iterator<char>()));
+    std::cout << "accepted " << parser.get_tokens().size() - 1 << " tokens with " << parser.get_stats().built_nodes << " nodes\n";
+  }
+  catch(const std::runtime_error& e) {
+    std::cerr << tokens_path << ": " << e.what() << "\n";
+    return 1;
+  }
+
+  int result = 0;
+  std::string line;
+  int line_num = 0;
+  while(std::getline(edits_stream, line)) {
+    ++line_num;
+
+    size_t offset, removed;
+    char separator = 0;
+    std::stringstream stream(line);
+    if(!(stream >> offset >> removed)) {
+      std::cerr << edits_path << ":" << line_num << ": expected an offset and a number of bytes to remove\n";
+      return 1;
+    }
+    stream.get(separator);
+
+    std::string inserted;
+    for(char c = 0; stream.get(c);) {
+      if(c == '\\' && stream.get(c)) {
+        c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
       }
+      inserted += c;
     }
 
-    out_stream << "\n";
+    try {
+      parser.edit(offset, removed, inserted);
+      const ReparseStats& stats = parser.get_stats();
+      std::cout << "edit " << line_num << ": relexed " << stats.relexed_tokens << " tokens, reused " << stats.reused_nodes << " nodes covering "
+        << stats.reused_tokens << " of " << parser.get_tokens().size() - 1 << " tokens, built " << stats.built_nodes << " nodes\n";
+    }
+    catch(const std::exception& e) {
+      std::cerr << edits_path << ":" << line_num << ": " << e.what() << "\n";
+      result = 1;
+    }
   }
 
-  out_stream.close();
+  std::cout << "built " << table.get_built_count() << " rows of " << table.get_state_count() << " states reached\n";
+  return result;
+}
+
+// Builds the whole table with options in generator and runs its passes
+// Returns 0 on success
+int build_table(LR1ParserTableGenerator& generator, const GeneratorOptions& options) {
+  generator.set_memory_budget(options.memory_budget);
+  generator.set_abort_on_conflict(options.abort_on_conflict);
+  generator.set_keep_conflicts(options.keep_conflicts);
+  generator.set_try_slr(options.try_slr);
+  try {
+    generator.build_parse_table();
+    generator.run_table_passes(options);
+  }
+  catch(const std::runtime_error& e) {
+    // A ConflictError, or a profile that doesn't fit the table
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
   return 0;
 }
 
+// Parses the file at tokens_path with the whole table built with options,
+// except the profile itself, and adds the cells it reads to the profile
+// at profile_path, which is created if it doesn't exist
+// Returns 0 if it is a sentence of grammar and the profile was saved
+int record_profile(const std::shared_ptr<const Grammar>& grammar, const std::string& tokens_path, LexerTables* lexer, GeneratorOptions options, const std::string& profile_path) {
+  options.profile.reset();
+
+  LR1ParserTableGenerator generator(grammar);
+  if(build_table(generator, options) != 0) {
+    return 1;
+  }
+  const int state_count = generator.get_parse_table().size();
+  const ParseTable table(generator);
+  if(lexer) {
+    LexerGenerator::map_tokens(*lexer, table.get_columns());
+  }
+
+  ParseProfile profile(state_count, table.get_columns().size());
+  if(std::filesystem::exists(profile_path)) {
+    try {
+      profile = ParseProfile::load(profile_path);
+      if(profile.get_state_count() != state_count || profile.get_col_count() != table.get_columns().size()) {
+        throw std::runtime_error(profile_path + " was recorded on a table of another size");
+      }
+    }
+    catch(const std::runtime_error& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  LRParser<ParseTable> parser(*grammar, table);
+  if(parse_file(parser, tokens_path, lexer, &profile) != 0) {
+    return 1;
+  }
+
+  if(!profile.save(profile_path)) {
+    std::cerr << "failed to write " << profile_path << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+
+  std::cout << "recorded profile in " << profile_path << "\n";
+  return 0;
+}
+
+// Parses the file at tokens_path with GLRParser over the whole table
+// built with options, keeping the conflicts precedence doesn't resolve
+// Returns 0 if it is a sentence of grammar
+int parse_glr(const std::shared_ptr<const Grammar>& grammar, const std::string& tokens_path, LexerTables* lexer, GeneratorOptions options) {
+  options.keep_conflicts = true;
+
+  LR1ParserTableGenerator generator(grammar);
+  if(build_table(generator, options) != 0) {
+    return 1;
+  }
+  print_conflicts(generator.get_conflict_counts());
+
+  const ParseTable table(generator);
+  if(lexer) {
+    LexerGenerator::map_tokens(*lexer, table.get_columns());
+  }
+
+  GLRParser<ParseTable> parser(*grammar, table);
+  return parse_file(tokens_path, lexer, [&](const auto& tokens) {
+    const ParseForest forest = parser.parse(tokens);
+    const uint64_t trees = forest.count_trees();
+    if(trees == std::numeric_limits<uint64_t>::max()) {
+      return std::string("with too many parse trees to count");
+    }
+    return "with " + std::to_string(trees) + (trees == 1 ? " parse tree" : " parse trees");
+  });
+}
+
+// Parses the source files listed in the file at list_path with a ParseService
+// of jobs threads, and prints the throughput and the latency percentiles
+// The table is read from table_path if set, else built with options
+// Returns 0 if every file parsed
+int parse_batch(const std::shared_ptr<const Grammar>& grammar, const std::string& list_path, LexerTables& lexer, const GeneratorOptions& options, const std::string& table_path, int jobs) {
+  std::vector<std::string> documents;
+  std::vector<std::string> paths;
+  std::ifstream list_stream(list_path);
+  if(!list_stream) {
+    std::cerr << "failed to open " << list_path << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+  for(std::string path; std::getline(list_stream, path);) {
+    if(path.empty() || path[0] == COMMENT_CHAR) {
+      continue;
+    }
+
+    std::ifstream in_stream(path);
+    if(!in_stream) {
+      std::cerr << "failed to open " << path << ": " << strerror(errno) << "\n";
+      return 1;
+    }
+    documents.emplace_back((std::istreambuf_iterator<char>(in_stream)), std::istreambuf_iterator<char>());
+    paths.push_back(path);
+  }
+
+  std::shared_ptr<const ParseTable> table;
+  std::unique_ptr<ParseService> service;
+  try {
+    if(!table_path.empty()) {
+      table = std::make_shared<const ParseTable>(ParseTable::load(table_path));
+    }
+    else {
+      LR1ParserTableGenerator generator(grammar);
+      if(build_table(generator, options) != 0) {
+        return 1;
+      }
+      table = std::make_shared<const ParseTable>(generator);
+    }
+    LexerGenerator::map_tokens(lexer, table->get_columns());
+    service.reset(new ParseService(*grammar, table, lexer, jobs));
+  }
+  catch(const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::vector<std::chrono::nanoseconds> latencies(documents.size());
+  size_t token_count = 0;
+  int failed = 0;
+  std::mutex result_mutex;
+
+  const auto start = std::chrono::steady_clock::now();
+  service->parse(documents, [&](size_t document, const ParseResult& result) {
+    latencies[document] = result.parse_time;
+
+    std::lock_guard<std::mutex> lock(result_mutex);
+    token_count += result.token_count;
+    if(!result.ok) {
+      std::cerr << paths[document] << ": " << result.error << "\n";
+      ++failed;
+    }
+  });
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    const auto latency = latencies.empty() ? std::chrono::nanoseconds(0) : latencies[std::min<size_t>(latencies.size() * p, latencies.size() - 1)];
+    return std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(latency).count()) + "us";
+  };
+
+  std::cout << "parsed " << documents.size() << " files with " << token_count << " tokens in " << elapsed.count() * 1000 << "ms on " << service->get_thread_count() << " threads\n";
+  std::cout << "throughput " << (size_t)(documents.size() / elapsed.count()) << " files/s, " << (size_t)(token_count / elapsed.count()) << " tokens/s\n";
+  std::cout << "latency p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999) << ", max " << percentile(1) << "\n";
+  return failed > 0;
+}
+
+// How often --watch checks the grammar file for changes
+const static std::chrono::milliseconds WATCH_INTERVAL(200);
+
+// Writes the table for the grammar file at grammar_path to output_path,
+// then again each time the file changes until the process is stopped
+// Each edit regenerates the previous table where it can, see
+// LR1ParserTableGenerator::regenerate. A grammar that fails to load or
+// build is reported and the next edit is built from scratch
+int watch_grammar(const std::string& grammar_path, const std::string& output_path, const std::vector<std::string>& start_symbols, const GeneratorOptions& options) {
+  std::unique_ptr<LR1ParserTableGenerator> generator;
+  std::filesystem::file_time_type last_write = std::filesystem::file_time_type::min();
+
+  std::cout << "watching " << grammar_path << " for changes" << std::endl;
+  for(;; std::this_thread::sleep_for(WATCH_INTERVAL)) {
+    std::error_code error;
+    const std::filesystem::file_time_type write_time = std::filesystem::last_write_time(grammar_path, error);
+    if(error || write_time == last_write) {
+      continue;
+    }
+    last_write = write_time;
+
+    std::shared_ptr<const Grammar> snapshot;
+    try {
+      Grammar grammar = load_grammar_file(grammar_path);
+      if(options.prune_grammar) {
+        print_grammar_reduction(grammar.remove_useless_productions(start_symbols));
+      }
+      grammar.add_augmented_production(start_symbols);
+      snapshot = Grammar::make_snapshot(std::move(grammar));
+    }
+    catch(const std::runtime_error& e) {
+      std::cerr << e.what() << "\n";
+      continue;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    bool patched = false;
+    if(!generator) {
+      generator.reset(new LR1ParserTableGenerator(snapshot));
+      if(build_table(*generator, options) != 0) {
+        generator.reset();
+        continue;
+      }
+    }
+    else {
+      try {
+        patched = generator->regenerate(snapshot);
+        generator->run_table_passes(options);
+      }
+      catch(const std::runtime_error& e) {
+        // The automaton is left half built
+        std::cerr << "error: " << e.what() << "\n";
+        generator.reset();
+        continue;
+      }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if(write_table(output_path, generator->get_parse_table(), generator->get_table_columns()) != 0) {
+      continue;
+    }
+    std::cout << (patched ? "patched " : "built ") << generator->get_parse_table().size() << " states in " << elapsed.count() * 1000 << "ms, wrote " << output_path << std::endl;
+    print_conflicts(generator->get_conflict_counts());
+  }
+}
+
+// Reads all of value as a number no larger than max for option
+// Throws std::invalid_argument if it isn't one
+uintmax_t parse_number(const std::string& option, const std::string& value, uintmax_t max = std::numeric_limits<uintmax_t>::max()) {
+  size_t end = 0;
+  uintmax_t number = 0;
+  try {
+    if(!value.empty() && isdigit((unsigned char)value[0])) {
+      number = std::stoull(value, &end);
+    }
+  }
+  catch(const std::out_of_range&) {
+    end = 0;
+  }
+
+  if(end == 0 || end != value.size() || number > max) {
+    throw std::invalid_argument("invalid value for " + option + ": " + value);
+  }
+  return number;
+}
+
 void print_usage() {
-  std::cout << "usage: set_generator <path/to/table/output>\n";
+  std::cout << "usage: set_generator [options] <path/to/table/output>\n";
+  std::cout << "       set_generator [options] --batch <manifest>\n";
+  std::cout << "       set_generator [options] --parse <tokens>\n";
+  std::cout << "       set_generator [options] --lexer <definitions> --parse-batch <list>\n";
+  std::cout << "  --batch <manifest>         generate the table for each grammar file and output path listed in <manifest>\n";
+  std::cout << "  -j <jobs>                  number of tables to generate at the same time in batch mode\n";
+  std::cout << "  --io-jobs <jobs>           number of tables to write at the same time in batch mode\n";
+  std::cout << "  --grammar <file>           generate the table for the grammar in <file>\n";
+  std::cout << "  --parse <tokens>           parse the terminals in <tokens>, only building the states the parse reaches\n";
+  std::cout << "  --lexer <definitions>      generate a lexer for the grammar's terminals, --parse then reads source text\n";
+  std::cout << "  --lexer-table <file>       write the lexer tables to <file>\n";
+  std::cout << "  --lexer-code <file>        write the lexer as C++ source to <file>\n";
+  std::cout << "  --start <symbol>           add <symbol> as a start symbol, repeat for one table with several starts\n";
+  std::cout << "  --slr                      build an SLR(1) table if the grammar is SLR(1), else the LR(1) table\n";
+  std::cout << "  --prune-grammar            remove unreachable and unproductive productions before generating\n";
+  std::cout << "  --eliminate-unit-productions  remove unit reductions like A -> B from the table\n";
+  std::cout << "  --minimize                 merge states that have the same actions and gotos\n";
+  std::cout << "  --compress-columns         merge columns that are the same in every state\n";
+  std::cout << "  --async-write              write the table on a background thread while it is generated\n";
+  std::cout << "  --cache-dir <dir>          reuse tables generated by earlier runs from <dir>\n";
+  std::cout << "  --cache-max-bytes <bytes>  limit the size of the cache directory\n";
+  std::cout << "  --memory-budget <bytes>    move finished item sets to disk once they take up more than <bytes>\n";
+  std::cout << "  --record-profile <file>    with --parse, add the table cells the parse reads to the profile in <file>\n";
+  std::cout << "  --profile <file>           order the table's states and columns by the profile in <file>\n";
+  std::cout << "  --abort-on-conflict        fail at the first conflict that precedence doesn't resolve\n";
+  std::cout << "  --conflict-report <file>   write every conflict that precedence doesn't resolve to <file>\n";
+  std::cout << "  --keep-conflicts           keep every action of a conflict that precedence doesn't resolve, like s5/r3\n";
+  std::cout << "  --parse-batch <list>       parse the source files listed in <list> on -j threads and report throughput and latency\n";
+  std::cout << "  --table <file>             with --parse-batch, read the table written to <file> instead of building it\n";
+  std::cout << "  --edits <file>             with --parse and --lexer, make the edits in <file> and reparse incrementally after each\n";
+  std::cout << "  --glr                      with --parse, parse with a GLR parser that follows every action of a conflict\n";
+  std::cout << "  --help                     print this message\n";
+  std::cout << "  --watch                    with --grammar, regenerate the table each time the grammar file changes\n";
+}
+
+// Generates the tables listed in the manifest at manifest_path
+// Returns 0 if every table was written
+int run_batch(const std::string& manifest_path, int jobs, int io_jobs, const std::string& cache_dir, uintmax_t cache_max_bytes, const GeneratorOptions& options) {
+  std::vector<BatchJob> batch;
+  try {
+    batch = read_batch_manifest(manifest_path);
+  }
+  catch(const GrammarLoadError& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::unique_ptr<GenerationCache> cache;
+  if(!cache_dir.empty()) {
+    cache.reset(new GenerationCache(cache_dir, cache_max_bytes));
+  }
+
+  std::cout << "generating " << batch.size() << " tables with " << jobs << " jobs\n";
+
+  BatchGenerator generator(jobs, io_jobs, cache.get(), options);
+  int failures = 0;
+  generator.run(batch, [&](const BatchJob& job, const BatchResult& result) {
+    if(result.ok) {
+      std::cout << (result.cached ? "cached " : "wrote ") << job.output_path << "\n";
+    }
+    else {
+      std::cerr << result.message << "\n";
+      ++failures;
+    }
+  });
+
+  if(failures > 0) {
+    std::cerr << failures << " of " << batch.size() << " tables failed\n";
+    return 1;
+  }
+
+  std::cout << "all tables successfully written\n";
+  return 0;
 }
 
 int main(int argc, char **argv) {
-  if(argc < 2) {
+  std::string output_path;
+  std::string grammar_path;
+  std::string cache_dir;
+  std::string manifest_path;
+  std::string tokens_path;
+  std::string lexer_path;
+  std::string lexer_table_path;
+  std::string lexer_code_path;
+  std::string record_profile_path;
+  std::string conflict_report_path;
+  std::vector<std::string> start_symbols;
+  int jobs = std::max(1u, std::thread::hardware_concurrency());
+  int io_jobs = DEFAULT_BATCH_IO_JOBS;
+  bool async_write = false;
+  bool glr = false;
+  bool watch = false;
+  std::string edits_path;
+  std::string parse_batch_path;
+  std::string table_path;
+  GeneratorOptions options;
+  uintmax_t cache_max_bytes = DEFAULT_CACHE_MAX_BYTES;
+
+  // Returns the value following the option at argv[i]
+  auto next_value = [&](int& i) {
+    if(i + 1 >= argc) {
+      throw std::invalid_argument(std::string(argv[i]) + " needs a value");
+    }
+    return std::string(argv[++i]);
+  };
+
+  try {
+    for(int i = 1; i < argc; ++i) {
+      std::string arg(argv[i]);
+
+      if(arg == "--grammar") {
+        grammar_path = next_value(i);
+      }
+      else if(arg == "--parse") {
+        tokens_path = next_value(i);
+      }
+      else if(arg == "--lexer") {
+        lexer_path = next_value(i);
+      }
+      else if(arg == "--lexer-table") {
+        lexer_table_path = next_value(i);
+      }
+      else if(arg == "--lexer-code") {
+        lexer_code_path = next_value(i);
+      }
+      else if(arg == "--batch") {
+        manifest_path = next_value(i);
+      }
+      else if(arg == "-j") {
+        jobs = parse_number(arg, next_value(i), std::numeric_limits<int>::max());
+      }
+      else if(arg == "--io-jobs") {
+        io_jobs = parse_number(arg, next_value(i), std::numeric_limits<int>::max());
+      }
+      else if(arg == "--start") {
+        start_symbols.push_back(next_value(i));
+      }
+      else if(arg == "--slr") {
+        options.try_slr = true;
+      }
+      else if(arg == "--prune-grammar") {
+        options.prune_grammar = true;
+      }
+      else if(arg == "--eliminate-unit-productions") {
+        options.eliminate_unit_productions = true;
+      }
+      else if(arg == "--minimize") {
+        options.minimize_states = true;
+      }
+      else if(arg == "--compress-columns") {
+        options.compress_columns = true;
+      }
+      else if(arg == "--async-write") {
+        async_write = true;
+      }
+      else if(arg == "--cache-dir") {
+        cache_dir = next_value(i);
+      }
+      else if(arg == "--cache-max-bytes") {
+        cache_max_bytes = parse_number(arg, next_value(i));
+      }
+      else if(arg == "--memory-budget") {
+        options.memory_budget = parse_number(arg, next_value(i));
+      }
+      else if(arg == "--abort-on-conflict") {
+        options.abort_on_conflict = true;
+      }
+      else if(arg == "--keep-conflicts") {
+        options.keep_conflicts = true;
+      }
+      else if(arg == "--parse-batch") {
+        parse_batch_path = next_value(i);
+      }
+      else if(arg == "--table") {
+        table_path = next_value(i);
+      }
+      else if(arg == "--edits") {
+        edits_path = next_value(i);
+      }
+      else if(arg == "--glr") {
+        glr = true;
+      }
+      else if(arg == "--watch") {
+        watch = true;
+      }
+      else if(arg == "--conflict-report") {
+        conflict_report_path = next_value(i);
+      }
+      else if(arg == "--record-profile") {
+        record_profile_path = next_value(i);
+      }
+      else if(arg == "--profile") {
+        try {
+          options.profile = std::make_shared<const ParseProfile>(ParseProfile::load(next_value(i)));
+        }
+        catch(const std::runtime_error& e) {
+          std::cerr << e.what() << "\n";
+          return 1;
+        }
+      }
+      else if(arg == "--help") {
+        print_usage();
+        return 0;
+      }
+      else if(arg.size() > 1 && arg[0] == '-') {
+        throw std::invalid_argument("unknown option " + arg);
+      }
+      else if(!output_path.empty()) {
+        throw std::invalid_argument("unexpected argument " + arg + " after the output path " + output_path);
+      }
+      else {
+        output_path = arg;
+      }
+    }
+
+  }
+  catch(const std::invalid_argument& e) {
+    std::cerr << e.what() << "\n";
+    print_usage();
+    return 1;
+  }
+
+  if(output_path.empty() && manifest_path.empty() && tokens_path.empty() && lexer_path.empty() && parse_batch_path.empty()) {
     print_usage();
     exit(0);
   }
 
+  if(!manifest_path.empty()) {
+    return run_batch(manifest_path, jobs, io_jobs, cache_dir, cache_max_bytes, options);
+  }
+
+  if(watch) {
+    if(grammar_path.empty() || output_path.empty()) {
+      std::cerr << "--watch needs --grammar and an output path\n";
+      return 1;
+    }
+    return watch_grammar(grammar_path, output_path, start_symbols, options);
+  }
+
   Grammar grammar(G2);
-  grammar.add_augmented_production();
+  if(!grammar_path.empty()) {
+    try {
+      grammar = load_grammar_file(grammar_path);
+    }
+    catch(const GrammarLoadError& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  }
 
-  LR1ParserTableGenerator generator(grammar);
+  try {
+    if(options.prune_grammar) {
+      print_grammar_reduction(grammar.remove_useless_productions(start_symbols));
+    }
+    grammar.add_augmented_production(start_symbols);
+  }
+  catch(const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
 
-  std::cout << "generating parse table\n";
+  // Everything from here on shares the one snapshot
+  const std::shared_ptr<const Grammar> snapshot = Grammar::make_snapshot(std::move(grammar));
 
-  std::vector<std::vector<std::string>> parse_table = generator.build_parse_table();
+  std::unique_ptr<LexerTables> lexer;
+  if(!lexer_path.empty()) {
+    lexer.reset(new LexerTables());
+    if(generate_lexer(snapshot, lexer_path, *lexer) != 0) {
+      return 1;
+    }
+  }
 
-  std::cout << "generating table symbols\n";
-  std::vector<std::string> symbols = generator.get_table_columns();
+  // With compressed or reordered columns the lexer gives the table's
+  // columns, which are only known once the table is built
+  const bool lexer_after_table = (options.compress_columns || options.profile) && tokens_path.empty() && !output_path.empty();
+  if(lexer && !lexer_after_table && write_lexer(*lexer, lexer_table_path, lexer_code_path) != 0) {
+    return 1;
+  }
 
-  std::string output_path(argv[1]);
+  if(!tokens_path.empty() && !record_profile_path.empty()) {
+    return record_profile(snapshot, tokens_path, lexer.get(), options, record_profile_path);
+  }
 
-  std::cout << "writing table output to " << output_path << "\n";
+  if(!parse_batch_path.empty()) {
+    if(!lexer) {
+      std::cerr << "--parse-batch needs a lexer\n";
+      return 1;
+    }
+    return parse_batch(snapshot, parse_batch_path, *lexer, options, table_path, jobs);
+  }
+
+  if(!tokens_path.empty() && !edits_path.empty()) {
+    if(!lexer) {
+      std::cerr << "--edits needs a lexer\n";
+      return 1;
+    }
+    return parse_edits(snapshot, tokens_path, *lexer, edits_path);
+  }
+
+  if(!tokens_path.empty() && glr) {
+    return parse_glr(snapshot, tokens_path, lexer.get(), options);
+  }
+
+  if(!tokens_path.empty()) {
+    return parse_tokens(snapshot, tokens_path, lexer.get());
+  }
+
+  if(output_path.empty()) {
+    return 0;
+  }
+
+  std::unique_ptr<GenerationCache> cache;
+  std::string cache_key;
+  CachedGeneration cached;
+  bool cache_hit = false;
+  if(!cache_dir.empty()) {
+    cache.reset(new GenerationCache(cache_dir, cache_max_bytes));
+    cache_key = GenerationCache::make_key(*snapshot, options.to_string());
+    cache_hit = cache->load(cache_key, cached);
+  }
+
+  if(cache_hit) {
+    std::cout << "using cached parse table " << GenerationCache::get_key_id(cache_key) << "\n";
+    std::cout << "writing table output to " << output_path << "\n";
+    if(write_table(output_path, cached.table, cached.cols) != 0) {
+      return 1;
+    }
+
+    if(lexer && lexer_after_table) {
+      LexerGenerator::map_tokens(*lexer, cached.cols);
+      if(write_lexer(*lexer, lexer_table_path, lexer_code_path) != 0) {
+        return 1;
+      }
+    }
 
-  int write_result = write_table(output_path, parse_table, symbols);
-  if(write_result == 0) {
+    print_conflicts(count_conflicts(cached.conflicts));
+    if(!conflict_report_path.empty() && write_conflict_report(conflict_report_path, cached.conflicts, *snapshot) != 0) {
+      return 1;
+    }
     std::cout << "table successfully written\n";
+    return 0;
+  }
+
+  LR1ParserTableGenerator generator(snapshot);
+  generator.set_memory_budget(options.memory_budget);
+  generator.set_abort_on_conflict(options.abort_on_conflict);
+  generator.set_keep_conflicts(options.keep_conflicts);
+  generator.set_try_slr(options.try_slr);
+
+  std::cout << "generating table symbols\n";
+  const std::vector<std::string>& symbols = generator.get_table_columns();
+
+  std::cout << "writing table output to " << output_path << "\n";
+  TableWriter writer(output_path, async_write);
+  if(!writer.is_open()) {
+    std::cerr << "failed to open output stream " << output_path << ": " << writer.get_error() << "\n";
+    return 1;
   }
 
-  return write_result;
-}
\ No newline at end of file
+  std::cout << "generating parse table\n";
+
+  try {
+    if(cache || options.has_table_passes()) {
+      // The cache and table passes need the whole table so keep it
+      generator.build_parse_table();
+
+      int state_count = generator.get_parse_table().size();
+      int col_count = symbols.size();
+      generator.run_table_passes(options);
+      if(options.has_table_passes()) {
+        std::cout << "table passes reduced " << state_count << " states to " << generator.get_parse_table().size() << "\n";
+      }
+      if(options.compress_columns) {
+        std::cout << "merged " << col_count << " columns into " << symbols.size() << " classes\n";
+      }
+
+      // Passes may have merged columns, so the header comes last
+      writer.write_header(symbols);
+      for(const auto& row : generator.get_parse_table()) {
+        writer.write_row(row);
+      }
+
+      if(cache && !cache->store(cache_key, CachedGeneration::capture(generator))) {
+        std::cerr << "failed to write cache entry " << GenerationCache::get_key_id(cache_key) << "\n";
+      }
+    }
+    else {
+      // Write each row as soon as its state is finished
+      writer.write_header(symbols);
+      generator.build_parse_table([&](int, const std::vector<std::string>& row) {
+        writer.write_row(row);
+      });
+    }
+  }
+  catch(const std::runtime_error& e) {
+    // A ConflictError, or a profile that doesn't fit the table
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+
+  if(!writer.close()) {
+    std::cerr << "failed to write " << output_path << ": " << writer.get_error() << "\n";
+    return 1;
+  }
+
+  if(lexer && lexer_after_table) {
+    LexerGenerator::map_tokens(*lexer, symbols);
+    if(write_lexer(*lexer, lexer_table_path, lexer_code_path) != 0) {
+      return 1;
+    }
+  }
+
+  if(options.try_slr) {
+    std::cout << (generator.is_slr() ? "grammar is SLR(1), built the SLR(1) table" : "grammar is not SLR(1), built the LR(1) table") << "\n";
+  }
+
+  if(generator.get_spilled_count() > 0) {
+    std::cout << "moved " << generator.get_spilled_count() << " of " << generator.get_state_count() << " item sets to disk\n";
+  }
+
+  print_conflicts(generator.get_conflict_counts());
+  if(!conflict_report_path.empty() && write_conflict_report(conflict_report_path, generator.get_conflicts(), *snapshot) != 0) {
+    return 1;
+  }
+  std::cout << "table successfully written\n";
+  return 0;
+}
@@ -0,0 +1,231 @@
+#ifndef _PARSE_PROFILE_HPP_
+#define _PARSE_PROFILE_HPP_
+
+#include <errno.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Counts of how a parser used a table while parsing a sample corpus
+ *
+ * For each (state, column) cell the parser read, the profile counts
+ * the reads, and for each pair of rows read one after the other, how
+ * often the second followed the first. A shift, or the goto after
+ * a reduce, is such a pair.
+ *
+ * States and columns are numbers in the table the profile was recorded
+ * on, so the profile only applies to a table built from the same grammar
+ * with the same options. See LR1ParserTableGenerator::order_by_profile
+ *
+ * Recording is not thread safe. Give each thread its own profile and merge them.
+ */
+class ParseProfile {
+  public:
+    ParseProfile() {}
+
+    // A profile for a table with state_count rows and col_count columns
+    ParseProfile(int state_count, int col_count) : state_count(state_count), col_count(col_count) {}
+
+    /**
+     * Reads a profile written by save
+     * Throws std::runtime_error if path can't be read or is malformed
+     */
+    static ParseProfile load(const std::string& path) {
+      std::ifstream in_stream(path);
+      if(!in_stream) {
+        throw std::runtime_error("failed to open " + path + ": " + strerror(errno));
+      }
+
+      ParseProfile profile;
+      std::string line;
+      int line_num = 0;
+      while(std::getline(in_stream, line)) {
+        ++line_num;
+
+        std::stringstream stream(line);
+        std::string kind;
+        int64_t a = 0, b = 0;
+        uint64_t count = 0;
+        if(!(stream >> kind) || kind[0] == '#') {
+          continue;
+        }
+
+        if(!(stream >> a >> b) || a < 0 || b < 0) {
+          throw std::runtime_error(path + ":" + std::to_string(line_num) + ": expected two numbers after " + kind);
+        }
+
+        if(kind == TABLE_LINE) {
+          profile.state_count = a;
+          profile.col_count = b;
+        }
+        else if(kind == CELL_LINE && (stream >> count)) {
+          profile.cells[get_key(a, b)] += count;
+        }
+        else if(kind == TRANSITION_LINE && (stream >> count)) {
+          profile.transitions[get_key(a, b)] += count;
+        }
+        else {
+          throw std::runtime_error(path + ":" + std::to_string(line_num) + ": malformed profile line");
+        }
+      }
+
+      return profile;
+    }
+
+    /**
+     * Writes the profile to path as text
+     *
+     *  table <states> <columns>
+     *  cell <state> <column> <count>
+     *  transition <from state> <to state> <count>
+     *
+     * Returns false if path could not be written
+     */
+    bool save(const std::string& path) const {
+      std::ofstream out_stream(path);
+      out_stream << TABLE_LINE << " " << state_count << " " << col_count << "\n";
+      for(const auto& entry : cells) {
+        out_stream << CELL_LINE << " " << (entry.first >> 32) << " " << (entry.first & 0xffffffff) << " " << entry.second << "\n";
+      }
+      for(const auto& entry : transitions) {
+        out_stream << TRANSITION_LINE << " " << (entry.first >> 32) << " " << (entry.first & 0xffffffff) << " " << entry.second << "\n";
+      }
+
+      return (bool)out_stream;
+    }
+
+    // Marks the start of a parse, so its first row doesn't follow
+    // the last row of the parse before it
+    void begin_parse() {
+      last_state = -1;
+    }
+
+    // Counts a read of the cell of state and col
+    void record(int state, int col) {
+      ++cells[get_key(state, col)];
+
+      if(last_state >= 0 && last_state != state) {
+        ++transitions[get_key(last_state, state)];
+      }
+      last_state = state;
+    }
+
+    // Adds the counts of other, which must be for the same table
+    // Throws std::runtime_error if other is for a table of another size
+    void merge(const ParseProfile& other) {
+      if(other.state_count != state_count || other.col_count != col_count) {
+        throw std::runtime_error("can't merge profiles of tables with different sizes");
+      }
+
+      for(const auto& entry : other.cells) {
+        cells[entry.first] += entry.second;
+      }
+      for(const auto& entry : other.transitions) {
+        transitions[entry.first] += entry.second;
+      }
+    }
+
+    int get_state_count() const {
+      return state_count;
+    }
+
+    int get_col_count() const {
+      return col_count;
+    }
+
+    // Returns the number of reads of each row
+    std::vector<uint64_t> get_state_counts() const {
+      std::vector<uint64_t> counts(state_count, 0);
+      for(const auto& entry : cells) {
+        const uint64_t state = entry.first >> 32;
+        if(state < counts.size()) {
+          counts[state] += entry.second;
+        }
+      }
+
+      return counts;
+    }
+
+    // Returns the number of reads of each column
+    std::vector<uint64_t> get_col_counts() const {
+      std::vector<uint64_t> counts(col_count, 0);
+      for(const auto& entry : cells) {
+        const uint64_t col = entry.first & 0xffffffff;
+        if(col < counts.size()) {
+          counts[col] += entry.second;
+        }
+      }
+
+      return counts;
+    }
+
+    // Returns the rows read right after each row as (state, count) pairs
+    std::vector<std::vector<std::pair<int, uint64_t>>> get_successors() const {
+      std::vector<std::vector<std::pair<int, uint64_t>>> successors(state_count);
+      for(const auto& entry : transitions) {
+        const uint64_t from = entry.first >> 32;
+        const uint64_t to = entry.first & 0xffffffff;
+        if(from < successors.size() && to < successors.size()) {
+          successors[from].emplace_back(to, entry.second);
+        }
+      }
+
+      return successors;
+    }
+
+    // Returns a 64 bit FNV-1a hash of the counts, e.g. for cache keys
+    uint64_t get_hash() const {
+      uint64_t hash = 14695981039346656037ULL;
+      auto add = [&](uint64_t value) {
+        for(int i = 0; i < 8; ++i) {
+          hash ^= (value >> (i * 8)) & 0xff;
+          hash *= 1099511628211ULL;
+        }
+      };
+
+      add(state_count);
+      add(col_count);
+      for(const auto* counts : {&cells, &transitions}) {
+        std::vector<std::pair<uint64_t, uint64_t>> sorted(counts->begin(), counts->end());
+        std::sort(sorted.begin(), sorted.end());
+
+        add(sorted.size());
+        for(const auto& entry : sorted) {
+          add(entry.first);
+          add(entry.second);
+        }
+      }
+
+      return hash;
+    }
+
+  private:
+    constexpr static const char* TABLE_LINE = "table";
+    constexpr static const char* CELL_LINE = "cell";
+    constexpr static const char* TRANSITION_LINE = "transition";
+
+    int state_count = 0;
+    int col_count = 0;
+
+    // Keyed by get_key(state, col)
+    std::unordered_map<uint64_t, uint64_t> cells;
+
+    // Keyed by get_key(from, to)
+    std::unordered_map<uint64_t, uint64_t> transitions;
+
+    // The row of the last cell recorded in this parse, or -1
+    int last_state = -1;
+
+    static uint64_t get_key(uint64_t a, uint64_t b) {
+      return a << 32 | b;
+    }
+};
+
+#endif /* _PARSE_PROFILE_HPP_ */
@@ -0,0 +1,275 @@
+#ifndef _PARSE_SERVICE_HPP_
+#define _PARSE_SERVICE_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grammar.hpp"
+#include "lr_parser.hpp"
+#include "scanner.hpp"
+
+/**
+ * The outcome of parsing one document of a ParseService batch
+ */
+struct ParseResult {
+  // False if the document failed to scan or parse, see error
+  bool ok = false;
+
+  size_t token_count = 0;
+
+  // The productions reduced by, as from LRParser::parse
+  // Only valid during the callback it is passed to
+  const std::vector<int>* reductions = nullptr;
+
+  std::string error;
+
+  // Time spent scanning and parsing the document
+  std::chrono::nanoseconds parse_time{0};
+};
+
+/**
+ * Parses batches of documents on a pool of threads that share one table
+ *
+ * The table, lexer and parser are shared by every thread and only read,
+ * so memory doesn't grow with the number of threads. Each thread keeps a
+ * ParseContext and a token vector it reuses from one document to the next,
+ * so once they have grown a parse allocates nothing.
+ *
+ * The threads are started once and wait between batches. A batch is
+ * split into a range of documents per thread. A thread takes documents
+ * from the front of its own range, and when that runs out it steals the
+ * back half of another thread's range, so a few long documents don't
+ * leave the other threads idle. The calling thread works as one of them.
+ *
+ * One batch runs at a time. Calls to parse from several threads take turns.
+ */
+class ParseService {
+  public:
+    /**
+     * lexer's token ids must be the columns of table, see
+     * LexerGenerator::map_tokens, and grammar must be the grammar
+     * the table was built from
+     *
+     * Throws std::runtime_error if table reduces by productions
+     * grammar doesn't have, see ParseTable::check_grammar
+     */
+    ParseService(const Grammar& grammar, std::shared_ptr<const ParseTable> table, const LexerTables& lexer, int threads = std::thread::hardware_concurrency()) :
+      table(std::move(table)),
+      parser(grammar, *this->table),
+      lexer(lexer),
+      scanner(this->lexer) {
+      this->table->check_grammar(grammar);
+
+      threads = std::max(threads, 1);
+      for(int i = 0; i < threads; ++i) {
+        workers.emplace_back(new Worker());
+      }
+
+      // The calling thread is worker 0
+      for(int i = 1; i < threads; ++i) {
+        pool.emplace_back(&ParseService::run, this, i);
+      }
+    }
+
+    ~ParseService() {
+      {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        stopping = true;
+      }
+      start_cv.notify_all();
+
+      for(std::thread& thread : pool) {
+        thread.join();
+      }
+    }
+
+    ParseService(const ParseService&) = delete;
+    ParseService& operator=(const ParseService&) = delete;
+
+    /**
+     * Parses each of documents and returns once all are done
+     *
+     * on_result is called with the index of each document and its result
+     * as soon as it is parsed. It is called from several threads at once
+     * and must not throw.
+     */
+    void parse(const std::vector<std::string>& documents, const std::function<void(size_t, const ParseResult&)>& on_result) {
+      std::lock_guard<std::mutex> batch_lock(batch_mutex);
+
+      // Even ranges to start with
+      const size_t worker_count = workers.size();
+      for(size_t i = 0; i < worker_count; ++i) {
+        std::lock_guard<std::mutex> lock(workers[i]->mutex);
+        workers[i]->next = documents.size() * i / worker_count;
+        workers[i]->end = documents.size() * (i + 1) / worker_count;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        batch_documents = &documents;
+        batch_on_result = &on_result;
+        busy_threads = pool.size();
+        ++batch;
+      }
+      start_cv.notify_all();
+
+      work(0);
+
+      std::unique_lock<std::mutex> lock(pool_mutex);
+      done_cv.wait(lock, [this]() { return busy_threads == 0; });
+      batch_documents = nullptr;
+      batch_on_result = nullptr;
+    }
+
+    int get_thread_count() const {
+      return workers.size();
+    }
+
+    const ParseTable& get_table() const {
+      return *table;
+    }
+
+  private:
+    // The documents left to a thread, [next, end) of the batch, and the
+    // buffers it reuses. Aligned so threads don't share cache lines.
+    struct alignas(64) Worker {
+      std::mutex mutex;
+      size_t next = 0;
+      size_t end = 0;
+
+      ParseContext context;
+      std::vector<int> tokens;
+    };
+
+    const std::shared_ptr<const ParseTable> table;
+    const LRParser<ParseTable> parser;
+    const LexerTables lexer;
+    const Scanner scanner;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> pool;
+
+    // Held for the whole of a batch
+    std::mutex batch_mutex;
+
+    // Guards the batch the pool is working on
+    std::mutex pool_mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    uint64_t batch = 0;
+    size_t busy_threads = 0;
+    bool stopping = false;
+    const std::vector<std::string>* batch_documents = nullptr;
+    const std::function<void(size_t, const ParseResult&)>* batch_on_result = nullptr;
+
+    // Runs a pool thread, which works on each batch as it starts
+    void run(int worker) {
+      uint64_t last_batch = 0;
+      while(true) {
+        {
+          std::unique_lock<std::mutex> lock(pool_mutex);
+          start_cv.wait(lock, [&]() { return stopping || batch != last_batch; });
+          if(stopping) {
+            return;
+          }
+          last_batch = batch;
+        }
+
+        work(worker);
+
+        bool last;
+        {
+          std::lock_guard<std::mutex> lock(pool_mutex);
+          last = --busy_threads == 0;
+        }
+        if(last) {
+          done_cv.notify_one();
+        }
+      }
+    }
+
+    // Parses documents until there are none left to take or steal
+    void work(int worker) {
+      size_t document;
+      while(take(worker, document) || steal(worker, document)) {
+        parse_document(*workers[worker], document);
+      }
+    }
+
+    // Takes the next document of worker's own range
+    bool take(int worker, size_t& document) {
+      Worker& own = *workers[worker];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if(own.next == own.end) {
+        return false;
+      }
+
+      document = own.next++;
+      return true;
+    }
+
+    /**
+     * Moves the back half of the first other range with documents left
+     * to worker and takes the first of them
+     * Returns false if every range was empty
+     *
+     * At most one worker lock is held at a time. A range being moved is in
+     * no worker, so another thread may stop early, but the thief parses it.
+     */
+    bool steal(int worker, size_t& document) {
+      const int worker_count = workers.size();
+      for(int i = 1; i < worker_count; ++i) {
+        Worker& victim = *workers[(worker + i) % worker_count];
+
+        size_t begin, end;
+        {
+          std::lock_guard<std::mutex> lock(victim.mutex);
+          if(victim.next == victim.end) {
+            continue;
+          }
+
+          end = victim.end;
+          begin = end - (end - victim.next + 1) / 2;
+          victim.end = begin;
+        }
+
+        Worker& own = *workers[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.next = begin + 1;
+        own.end = end;
+        document = begin;
+        return true;
+      }
+
+      return false;
+    }
+
+    void parse_document(Worker& worker, size_t document) {
+      const std::string& text = (*batch_documents)[document];
+      ParseResult result;
+
+      const auto start = std::chrono::steady_clock::now();
+      try {
+        scanner.tokenize(text.data(), text.size(), worker.tokens);
+        result.token_count = worker.tokens.size() - 1;
+        result.reductions = &parser.parse(worker.tokens, worker.context);
+        result.ok = true;
+      }
+      catch(const std::exception& e) {
+        result.error = e.what();
+      }
+      result.parse_time = std::chrono::steady_clock::now() - start;
+
+      (*batch_on_result)(document, result);
+    }
+};
+
+#endif /* _PARSE_SERVICE_HPP_ */
@@ -1,8 +1,16 @@
 #ifndef _PARSE_TABLE_GENERATOR_HPP_
 #define _PARSE_TABLE_GENERATOR_HPP_
 
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <memory>
+#include <set>
+
+
 #include "grammar.hpp"
 #include "lr1_item.hpp"
+#include "parse_profile.hpp"
 #include "set_generator.hpp"
 
 // Table action for accepting the parse
@@ -14,23 +22,284 @@ const static std::string SHIFT_ACTION = "s";
 // Table action for reducing symbols by production j
 const static std::string REDUCE_ACTION = "r";
 
+// Returns true if action is a shift like s12
+bool is_shift_action(const std::string& action) {
+  return action.size() > SHIFT_ACTION.size() && action.compare(0, SHIFT_ACTION.size(), SHIFT_ACTION) == 0 &&
+    std::isdigit((unsigned char)action[SHIFT_ACTION.size()]);
+}
+
+// Returns true if action is a reduce like r3
+bool is_reduce_action(const std::string& action) {
+  return action.size() > REDUCE_ACTION.size() && action.compare(0, REDUCE_ACTION.size(), REDUCE_ACTION) == 0 &&
+    std::isdigit((unsigned char)action[REDUCE_ACTION.size()]);
+}
+
+// Returns true if action is the accept, which is also the first
+// action of an entry that kept an accept/reduce conflict like acct/r3
+bool is_accept_action(const std::string& action) {
+  return action.compare(0, ACCEPT_ACTION.size(), ACCEPT_ACTION) == 0;
+}
+
+// Returns true if action is a goto like 7
+bool is_goto_action(const std::string& action) {
+  return !action.empty() && std::isdigit((unsigned char)action[0]);
+}
+
+// Returns the state of a shift or goto, or the production of a reduce
+// s12 gives 12, r3 gives 3, 7 gives 7
+int get_action_number(const std::string& action) {
+  size_t start = 0;
+  while(start < action.size() && !std::isdigit((unsigned char)action[start])) {
+    ++start;
+  }
+
+  return std::stoi(action.substr(start));
+}
+
+// Separates the actions of a table entry that kept its conflict, like s5/r3
+// See LR1ParserTableGenerator::set_keep_conflicts
+// The first action is the one the entry would have been given, and a
+// shift always comes first, so code that reads a single action, like
+// is_shift_action and get_action_number, sees the resolved entry
+const static std::string CONFLICT_SEP = "/";
+
+// Returns true if action is an entry that kept its conflict like s5/r3
+bool is_conflict_action(const std::string& action) {
+  return action.find(CONFLICT_SEP) != std::string::npos;
+}
+
+// Returns the actions of a table entry
+// s5/r3 gives {"s5", "r3"}, r3 gives {"r3"} and an empty entry gives {}
+std::vector<std::string> get_entry_actions(const std::string& entry) {
+  std::vector<std::string> actions;
+  size_t start = 0;
+  while(start < entry.size()) {
+    size_t end = entry.find(CONFLICT_SEP, start);
+    if(end == std::string::npos) {
+      end = entry.size();
+    }
+    actions.push_back(entry.substr(start, end - start));
+    start = end + CONFLICT_SEP.size();
+  }
+
+  return actions;
+}
+
+// Returns the symbols of a table column
+// A column merged by LR1ParserTableGenerator::compress_columns is named
+// by its symbols separated by spaces, like 'BOOL' 'NUM' 'STRING'
+std::vector<std::string> get_column_symbols(const std::string& col) {
+  std::vector<std::string> symbols;
+  size_t start = 0;
+  while(start <= col.size()) {
+    size_t end = col.find(' ', start);
+    if(end == std::string::npos) {
+      end = col.size();
+    }
+    if(end > start) {
+      symbols.push_back(col.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+
+  return symbols;
+}
+
+// Default share of states that may be affected by a grammar edit before
+// LR1ParserTableGenerator::regenerate falls back to a full rebuild
+const static double DEFAULT_MAX_REBUILD_RATIO = 0.5;
+
+/**
+ * Options that change the generated table
+ */
+struct GeneratorOptions {
+  // Remove unproductive and unreachable productions from the grammar
+  // before generating. See Grammar::remove_useless_productions
+  // Not part of to_string since the pruned grammar is what gets hashed
+  bool prune_grammar = false;
+
+  // Remove unit reductions
+  // See LR1ParserTableGenerator::eliminate_unit_productions
+  bool eliminate_unit_productions = false;
+
+  // Build an SLR(1) table if the grammar is SLR(1), else an LR(1) one
+  // See LR1ParserTableGenerator::set_try_slr
+  bool try_slr = false;
+
+  // Merge states with the same behavior
+  // See LR1ParserTableGenerator::minimize_states
+  bool minimize_states = false;
+
+  // Merge columns that are the same in every state
+  // See LR1ParserTableGenerator::compress_columns
+  bool compress_columns = false;
+
+  // Lay the table out for the accesses recorded in the profile
+  // See LR1ParserTableGenerator::order_by_profile
+  std::shared_ptr<const ParseProfile> profile;
+
+  // Throw ConflictError at the first conflict precedence doesn't resolve
+  // Part of to_string so a cached table is known to be free of conflicts
+  bool abort_on_conflict = false;
+
+  // Keep every action of a conflict precedence doesn't resolve, for GLRParser
+  // See LR1ParserTableGenerator::set_keep_conflicts
+  bool keep_conflicts = false;
+
+  // Bytes the item sets may take up in memory before finished ones are
+  // moved out to disk, or 0 for no limit. See SetGenerator::set_memory_budget
+  // Not part of to_string since it doesn't change the table
+  size_t memory_budget = 0;
+
+  // Returns true if a pass needs the whole table once it is built,
+  // so rows can't be streamed out as their states finish
+  bool has_table_passes() const {
+    return eliminate_unit_productions || minimize_states || compress_columns || profile;
+  }
+
+  // Describes the options, e.g. for cache keys
+  std::string to_string() const {
+    std::string str = try_slr ? "slr1" : "lr1";
+    if(eliminate_unit_productions) {
+      str += ",eliminate-unit-productions";
+    }
+    if(minimize_states) {
+      str += ",minimize-states";
+    }
+    if(compress_columns) {
+      str += ",compress-columns";
+    }
+    if(profile) {
+      str += ",profile=" + std::to_string(profile->get_hash());
+    }
+    if(abort_on_conflict) {
+      str += ",abort-on-conflict";
+    }
+    if(keep_conflicts) {
+      str += ",keep-conflicts";
+    }
+
+    return str;
+  }
+};
+
+/**
+ * Conflicts that no precedence declaration resolved
+ */
+struct ConflictCounts {
+  // Resolved by shifting
+  int shift_reduce = 0;
+
+  // Resolved by reducing by the earlier production
+  int reduce_reduce = 0;
+
+  ConflictCounts& operator+=(const ConflictCounts& other) {
+    shift_reduce += other.shift_reduce;
+    reduce_reduce += other.reduce_reduce;
+    return *this;
+  }
+};
+
+enum class ConflictType {
+  SHIFT_REDUCE,
+  REDUCE_REDUCE
+};
+
+/**
+ * A table entry the grammar gives more than one action,
+ * which no precedence declaration resolved
+ *
+ * state is the item set as build_parse_table numbers them,
+ * before any table pass renumbers the states
+ */
+struct Conflict {
+  ConflictType type = ConflictType::SHIFT_REDUCE;
+  int state = 0;
+
+  // The terminal both actions are on
+  std::string symbol;
+
+  // The action the entry was given, like s5 or r3
+  std::string chosen;
+
+  // The reduce it was given over
+  std::string dropped;
+
+  /**
+   * Describes the conflict with the productions of grammar, e.g.
+   * state 12 on 'else': shift/reduce conflict, shift to 15 chosen over reduce by stmt -> 'if' expr stmt
+   */
+  std::string to_string(const Grammar& grammar) const {
+    return "state " + std::to_string(state) + " on " + symbol + ": " +
+      (type == ConflictType::SHIFT_REDUCE ? "shift/reduce" : "reduce/reduce") + " conflict, " +
+      describe_action(grammar, chosen) + " chosen over " + describe_action(grammar, dropped);
+  }
+
+  // Describes a shift, reduce or accept action like s5, r3 or acct
+  static std::string describe_action(const Grammar& grammar, const std::string& action) {
+    if(is_shift_action(action)) {
+      return "shift to " + std::to_string(get_action_number(action));
+    }
+    if(action == ACCEPT_ACTION) {
+      return "accept";
+    }
+    return "reduce by " + grammar[get_action_number(action)];
+  }
+};
+
+// Returns the number of each type of conflict in conflicts
+ConflictCounts count_conflicts(const std::vector<Conflict>& conflicts) {
+  ConflictCounts counts;
+  for(const Conflict& conflict : conflicts) {
+    if(conflict.type == ConflictType::SHIFT_REDUCE) {
+      ++counts.shift_reduce;
+    }
+    else {
+      ++counts.reduce_reduce;
+    }
+  }
+
+  return counts;
+}
+
+/**
+ * Thrown by LR1ParserTableGenerator with abort_on_conflict set
+ * at the first conflict it finds
+ */
+class ConflictError : public std::runtime_error {
+  public:
+    ConflictError(const Conflict& conflict, const Grammar& grammar) :
+      std::runtime_error(conflict.to_string(grammar)),
+      conflict(conflict) {}
+
+    const Conflict& get_conflict() const {
+      return conflict;
+    }
+
+  private:
+    Conflict conflict;
+};
+
 class LR1ParserTableGenerator {
   public:
-    LR1ParserTableGenerator(Grammar grammar) : grammar(grammar), set_generator(grammar) {
-      std::unordered_map<std::string, std::unordered_set<std::string>> first_sets = set_generator.build_first_sets();
-      std::vector<std::string> symbols;
-      for(auto it = first_sets.begin(); it != first_sets.end(); ++it) {
-        if((*it).first == AUGMENTED_LHS) {
-          continue;
-        }
-        symbols.push_back((*it).first);
-      }
+    /**
+     * The generator and its SetGenerator share grammar, so it is
+     * never copied
+     */
+    LR1ParserTableGenerator(std::shared_ptr<const Grammar> grammar) : grammar(grammar), set_generator(grammar) {
+      set_generator.build_first_sets();
 
       // Get list of terminals and non-terminals to fill out
       // indices of symbol_cols
-      build_symbol_cols(grammar.get_terminals(), grammar.get_non_terminals());
+      build_symbol_cols(grammar->get_terminals(), grammar->get_non_terminals());
     };
 
+    // Takes grammar as the snapshot to share
+    LR1ParserTableGenerator(Grammar grammar) : LR1ParserTableGenerator(Grammar::make_snapshot(std::move(grammar))) {}
+
+    LR1ParserTableGenerator(const LR1ParserTableGenerator&) = delete;
+    LR1ParserTableGenerator& operator=(const LR1ParserTableGenerator&) = delete;
+
     /**
      * Builds the Action and GOTO LR(1) tables for the provided grammar.
      * 
@@ -45,75 +314,835 @@ class LR1ParserTableGenerator {
      *      set table[i, symbol_cols[a]] = shift j.
      * 2b. If [A → α ⋅, t] is in Ii and A != S', set table[i, symbol_cols[t]] = reduce A → α
      * 2c. If [S' -> S ⋅, $] is in Ii, set table[i, symbol_cols[$]] = accept
+     *
+     * With several start symbols, C' starts from the closure of each
+     * augmented item, so state i is the start state of start symbol i and
+     * every S'A -> A ⋅ gets an accept. See Grammar::add_augmented_production
      * 3. If [A → α ⋅ A β, t] in Ii and A is a non-terminal and GOTO(Ii, A) = Ij,
      *      set table[i, symbol_cols[A]] = j
      * 4. Entires not filled in by above rules are errors
+     *
+     * Where the grammar isn't LR(1) an entry gets more than one action.
+     * See fill_row for how those conflicts are resolved.
+     *
+     * Each row is filled as soon as the gotos of its state are known,
+     * so with a memory budget the item set can be moved out right after.
      */ 
-    std::vector<std::vector<std::string>> build_parse_table() {
-      std::set<std::set<LR1Item, LR1Comparator>, LR1SetComparator> item_sets = set_generator.build_item_sets();
-      const std::unordered_map<std::string, int>& goto_indices = set_generator.get_goto_indices();
+    const std::vector<std::vector<std::string>>& build_parse_table() {
+      // Remove any previous table
+      table.clear();
+      row_conflicts.clear();
+      slr = false;
+      passes_run = false;
+
+      if(try_slr && build_slr_table()) {
+        return table;
+      }
+
+      // Item set state == Istate
+      set_generator.build_item_sets([&](int state) {
+        table.emplace_back(symbol_cols.size());
+        fill_row(state, table[state]);
+        set_generator.spill_finished_states(state);
+      });
+
+      return table;
+    };
+
+    /**
+     * Builds the parse table as above without keeping it
+     *
+     * Each row is passed to on_row as soon as its state is finished,
+     * in state order, while the remaining item sets are still being
+     * built. The row is reused for the next state so on_row has to
+     * copy anything it wants to keep.
+     *
+     * An SLR(1) table is only known to be free of conflicts once every
+     * row is filled, so it is built whole and then passed row by row
+     */
+    void build_parse_table(const std::function<void(int, const std::vector<std::string>&)>& on_row) {
+      // Remove any previous table
+      table.clear();
+      row_conflicts.clear();
+      slr = false;
+      passes_run = false;
+
+      if(try_slr && build_slr_table()) {
+        for(int state = 0; state < table.size(); ++state) {
+          on_row(state, table[state]);
+        }
+        table.clear();
+        return;
+      }
+
+      std::vector<std::string> row(symbol_cols.size());
+      set_generator.build_item_sets([&](int state) {
+        for(std::string& action : row) {
+          action.clear();
+        }
+
+        fill_row(state, row);
+        on_row(state, row);
+        set_generator.spill_finished_states(state);
+      });
+    }
+
+    /**
+     * Starts building the parse table one row at a time
+     *
+     * Only I0 is built. Each build_row call then finds the gotos of one
+     * state, adding the states they lead to, and fills its row. States
+     * are numbered in the order they are discovered, so the numbers
+     * depend on which rows are asked for first.
+     *
+     * The cached table is not used. See LazyParseTable
+     */
+    void begin_rows() {
+      table.clear();
+      row_conflicts.clear();
+      slr = false;
+      passes_run = false;
+      set_generator.begin_item_sets();
+    }
+
+    /**
+     * Fills row with the actions and gotos of state
+     *
+     * Assumes begin_rows was called and state is less than get_state_count.
+     * Each state should only be built once.
+     */
+    void build_row(int state, std::vector<std::string>& row) {
+      row.assign(symbol_cols.size(), "");
+      set_generator.expand_item_set(state);
+      fill_row(state, row);
+    }
+
+    // Returns the number of item sets found so far
+    size_t get_state_count() const {
+      return set_generator.get_state_count();
+    }
+
+    /**
+     * Sets the bytes the item sets may take up in memory while
+     * build_parse_table runs, or 0 for no limit
+     *
+     * Past the budget, the sets of finished states and their gotos are
+     * moved to a file in the system temporary directory and only read
+     * back when asked for. The table is the same either way, it just
+     * takes longer to build. The table itself is not counted, so use
+     * the streaming build_parse_table to keep it out of memory too.
+     */
+    void set_memory_budget(size_t bytes) {
+      set_generator.set_memory_budget(bytes);
+    }
+
+    // Returns the number of item sets moved out of memory
+    size_t get_spilled_count() const {
+      return set_generator.get_spilled_count();
+    }
+
+    /**
+     * Makes the builds throw ConflictError at the first conflict that
+     * precedence doesn't resolve
+     *
+     * Each row is checked as soon as its item set is complete, so a
+     * grammar that isn't LR(1) fails without building the rest of the
+     * automaton. The table is left half built.
+     */
+    void set_abort_on_conflict(bool abort) {
+      abort_on_conflict = abort;
+    }
+
+    /**
+     * Makes the builds keep every action of a conflict that precedence
+     * doesn't resolve, joined by CONFLICT_SEP like s5/r3, for GLRParser
+     *
+     * The action the entry would otherwise get comes first, so LRParser
+     * still parses the way yacc would with such a table. Conflicts are
+     * counted and reported the same either way.
+     */
+    void set_keep_conflicts(bool keep) {
+      keep_conflicts = keep;
+    }
+
+    /**
+     * Makes build_parse_table try an SLR(1) table first
+     *
+     * The LR(0) automaton has no lookaheads, so it has far fewer states
+     * than the LR(1) one and is much cheaper to build. If any entry of
+     * the SLR(1) table gets more than one action, the LR(1) table is
+     * built instead, even when precedence would settle the conflict:
+     * FOLLOW sets can hold terminals that never follow in that state,
+     * and settling such a conflict can reject valid input.
+     *
+     * Rows built with begin_rows and build_row are always LR(1)
+     */
+    void set_try_slr(bool try_slr) {
+      this->try_slr = try_slr;
+    }
+
+    // Returns true if the last table built is an SLR(1) table
+    bool is_slr() const {
+      return slr;
+    }
+
+    /**
+     * Regenerates the parse table for new_grammar, an edited version
+     * of the grammar the current table was built from.
+     *
+     * The previous automaton and FIRST sets are kept. Only the states
+     * whose closures reach a symbol affected by the edit are derived
+     * again and the rows of the other states are copied from the
+     * previous table with their state numbers remapped.
+     *
+     * If no table has been built yet, a table pass has run over it, or
+     * more than max_rebuild_ratio of the previous states are affected,
+     * the table is rebuilt from scratch. Run the passes again afterwards.
+     *
+     * Either way the result is the same table a full build would give.
+     * Returns true if the previous table was patched, false if it was rebuilt.
+     */
+    bool regenerate(Grammar new_grammar, double max_rebuild_ratio = DEFAULT_MAX_REBUILD_RATIO) {
+      return regenerate(Grammar::make_snapshot(std::move(new_grammar)), max_rebuild_ratio);
+    }
+
+    bool regenerate(std::shared_ptr<const Grammar> new_grammar, double max_rebuild_ratio = DEFAULT_MAX_REBUILD_RATIO) {
+      std::vector<std::vector<std::string>> previous_table = std::move(table);
+      std::vector<std::string> previous_cols = std::move(cols);
+      std::vector<std::vector<Conflict>> previous_conflicts = std::move(row_conflicts);
+      table.clear();
+      cols.clear();
+      symbol_cols.clear();
+      row_conflicts.clear();
+
+      // Precedence changes how any row is resolved
+      const bool same_precedence = grammar->get_precedence_str() == new_grammar->get_precedence_str();
 
-      int state = 0;
-      for(const auto& item_set : item_sets) {
-        // Add state row if needed
-        if(state >= table.size()) {
-          std::vector<std::string> row(symbol_cols.size());
-          table.push_back(row);
+      grammar = new_grammar;
+      std::unordered_set<std::string> affected = set_generator.update_grammar(std::move(new_grammar));
+      build_symbol_cols(grammar->get_terminals(), grammar->get_non_terminals());
+
+      // Spilled sets would have to be read back to be compared
+      std::vector<bool> reusable = set_generator.get_reusable_sets(affected);
+      size_t rebuild_count = std::count(reusable.begin(), reusable.end(), false);
+      // The sets of an SLR(1) table are LR(0) sets, and an SLR(1)
+      // table may turn into an LR(1) one and back. After a table pass
+      // the rows are no longer numbered by item set
+      if(previous_table.empty() || !same_precedence || set_generator.get_spilled_count() > 0 || try_slr || slr || passes_run ||
+         rebuild_count > max_rebuild_ratio * reusable.size()) {
+        build_parse_table();
+        return false;
+      }
+
+      std::vector<int> previous_to_new = set_generator.rebuild_item_sets(reusable);
+      const std::vector<std::set<LR1Item, LR1Comparator>>& item_sets = set_generator.get_item_sets();
+      table.resize(item_sets.size(), std::vector<std::string>(symbol_cols.size()));
+      row_conflicts.resize(item_sets.size());
+
+      // Rows can only be copied if their columns are in the same place
+      std::vector<bool> patched(item_sets.size(), false);
+      if(cols == previous_cols) {
+        for(int i = 0; i < previous_table.size(); ++i) {
+          int state = previous_to_new[i];
+          if(!reusable[i] || state < 0) {
+            continue;
+          }
+
+          table[state] = remap_row(previous_table[i], previous_to_new);
+          row_conflicts[state] = previous_conflicts[i];
+          for(Conflict& conflict : row_conflicts[state]) {
+            conflict.state = state;
+          }
+          patched[state] = true;
         }
-        // item_set == Ii
-        for(const auto& item : item_set) {
-          // item is of the form [A → α ⋅ a B β, t]
+      }
 
-          // If item is [A → α ⋅ a β, t], next_symbol == a
-          std::string next_symbol = item.get_next_symbol();
+      for(int state = 0; state < item_sets.size(); ++state) {
+        if(!patched[state]) {
+          fill_row(state, table[state]);
+        }
+      }
 
-          // The marker is to the right of the rhs
-          // item is [A → α ⋅, t] or [S' -> S ⋅, $]
-          if(next_symbol == EPSILON || next_symbol.empty()) {
-            if(item.is_augmented_production()) { //[S' -> S ⋅, $]
-              table[state][symbol_cols[DOLLAR]] = ACCEPT_ACTION;
+      return true;
+    }
+
+    // Runs the passes enabled in options over the cached table
+    void run_table_passes(const GeneratorOptions& options) {
+      if(options.eliminate_unit_productions) {
+        eliminate_unit_productions();
+      }
+      if(options.minimize_states) {
+        minimize_states();
+      }
+      if(options.compress_columns) {
+        compress_columns();
+      }
+      if(options.profile) {
+        order_by_profile(*options.profile);
+      }
+    }
+
+    /**
+     * Removes unit reductions from the cached table
+     *
+     * A unit production has a single non-terminal on its rhs, like
+     * expression -> logic_expression. Given GOTO(Ip, B) = Iq where all
+     * Iq does is reduce by A -> B, the parser would reduce, pop back to p
+     * and take GOTO(Ip, A). So the goto on B in state p is pointed
+     * straight at GOTO(Ip, A) and the reduction never happens. This is
+     * repeated until no chains are left, so a leaf goes straight to the
+     * state at the end of a chain like term_expression -> ... -> expression.
+     *
+     * In canonical LR(1), Iq reduces on exactly the lookaheads that
+     * GOTO(Ip, A) does not reject, so errors are still caught on the
+     * same token.
+     *
+     * The productions in keep have semantic actions and are not removed.
+     * States that can no longer be reached are dropped and the remaining
+     * states are renumbered in order. Reduce actions keep their production
+     * numbers, and the item sets keep their original numbering.
+     *
+     * Returns the number of states removed
+     */
+    int eliminate_unit_productions(const std::set<int>& keep = {}) {
+      passes_run = true;
+      // unit_productions[q] is the unit production state q only reduces by, or -1
+      std::vector<int> unit_productions(table.size(), -1);
+      for(int q = 0; q < table.size(); ++q) {
+        int production = -1;
+        bool only_unit_reduce = true;
+
+        for(const std::string& action : table[q]) {
+          if(action.empty()) {
+            continue;
+          }
+
+          if(!is_reduce_action(action) || is_conflict_action(action) ||
+             (production >= 0 && get_action_number(action) != production)) {
+            only_unit_reduce = false;
+            break;
+          }
+          production = get_action_number(action);
+        }
+
+        if(only_unit_reduce && production >= 0 && keep.count(production) == 0 && is_unit_production(production)) {
+          unit_productions[q] = production;
+        }
+      }
+
+      // Each pass moves a goto at least one step up its chain, so the
+      // number of states bounds the passes even for cyclic unit rules
+      bool changed = true;
+      for(int pass = 0; changed && pass < table.size(); ++pass) {
+        changed = false;
+
+        for(auto& row : table) {
+          for(int col = symbol_cols[DOLLAR] + 1; col < row.size(); ++col) {
+            if(!is_goto_action(row[col])) {
+              continue;
+            }
+
+            int production = unit_productions[get_action_number(row[col])];
+            if(production < 0) {
+              continue;
+            }
+
+            // row[col] is GOTO(Ip, B) and only reduces by A -> B
+            const std::string& lhs = grammar->get_symbol(grammar->get_production(production).lhs);
+            const std::string& target = row[symbol_cols[lhs]];
+            if(target.empty() || target == row[col]) {
+              continue;
+            }
+
+            row[col] = target;
+            changed = true;
+          }
+        }
+      }
+
+      return remove_unreachable_states();
+    }
+
+    /**
+     * Merges the states of the cached table that behave the same
+     *
+     * Two states are equivalent if they have the same reduce and accept
+     * actions, shift and goto on the same symbols, and every shift or
+     * goto leads to equivalent states. The equivalence classes are found
+     * by partition refinement in the style of Hopcroft's DFA minimization:
+     * 
+     * 1. Start with the states grouped by their actions, with shift and
+     *    goto targets left out
+     * 2. Put every (block, symbol) pair on a worklist
+     * 3. For each (A, X) taken off the worklist, split every block Y into
+     *    the states whose move on X leads into A and the rest
+     * 4. When Y is split, both halves replace (Y, X') on the worklist if it
+     *    was waiting. Otherwise only the smaller half is added.
+     *
+     * Each block becomes one state. The block holding state 0 stays state 0
+     * and the others are numbered by their lowest original state. With
+     * several start symbols, the start states are never merged with each
+     * other or any state and all keep their numbers.
+     * The item sets keep their original numbering.
+     *
+     * Returns the number of states removed
+     */
+    int minimize_states() {
+      passes_run = true;
+      const int state_count = table.size();
+      if(state_count == 0) {
+        return 0;
+      }
+      const int col_count = table[0].size();
+
+      // 1. Group states by their actions without shift and goto targets
+      // With several start symbols, each start state is a block of its own
+      // so none is merged into another
+      const int start_count = get_start_count();
+      std::vector<int> block_of(state_count);
+      std::vector<std::vector<int>> blocks;
+      {
+        std::unordered_map<std::string, int> block_indices;
+        for(int state = 0; state < state_count; ++state) {
+          std::string key = start_count > 1 && state < start_count ? std::to_string(state) + ":" : "";
+          for(const std::string& action : table[state]) {
+            if(is_conflict_action(action)) {
+              // Only a shift target can differ, and it comes first
+              key += is_shift_action(action) ? SHIFT_ACTION + action.substr(action.find(CONFLICT_SEP)) : action;
+            }
+            else if(is_shift_action(action)) {
+              key += SHIFT_ACTION;
+            }
+            else if(is_goto_action(action)) {
+              key += "g";
             }
             else {
-              table[state][symbol_cols[item.get_lookahead()]] = REDUCE_ACTION + std::to_string(item.get_production_num());
+              key += action;
             }
+            key += ',';
           }
-          else {
-            // item is [A → α ⋅ a B β, t] or [A → α ⋅ A B β, t]
-            std::string goto_key = std::to_string(state) + "," + next_symbol;
-            if(goto_indices.count(goto_key) == 0) {
-              // throw std::runtime_error(goto_key + " not found in goto_indices map.");
+
+          auto result = block_indices.emplace(key, blocks.size());
+          if(result.second) {
+            blocks.push_back({});
+          }
+          block_of[state] = result.first->second;
+          blocks[result.first->second].push_back(state);
+        }
+      }
+
+      // predecessors[col][state] holds the states that move to state on col
+      std::vector<std::vector<std::vector<int>>> predecessors(col_count, std::vector<std::vector<int>>(state_count));
+      std::vector<bool> has_moves(col_count, false);
+      for(int state = 0; state < state_count; ++state) {
+        for(int col = 0; col < col_count; ++col) {
+          const std::string& action = table[state][col];
+          if(is_shift_action(action) || is_goto_action(action)) {
+            predecessors[col][get_action_number(action)].push_back(state);
+            has_moves[col] = true;
+          }
+        }
+      }
+
+      // 2. Every (block, symbol) pair starts on the worklist
+      std::vector<std::pair<int, int>> worklist;
+      std::vector<std::vector<bool>> waiting;
+      for(int block = 0; block < blocks.size(); ++block) {
+        waiting.push_back(std::vector<bool>(col_count, false));
+        for(int col = 0; col < col_count; ++col) {
+          if(has_moves[col]) {
+            worklist.push_back({block, col});
+            waiting[block][col] = true;
+          }
+        }
+      }
+
+      // Scratch space for step 3
+      std::vector<int> marked_count;
+      std::vector<bool> marked(state_count, false);
+
+      while(!worklist.empty()) {
+        const int splitter = worklist.back().first;
+        const int col = worklist.back().second;
+        worklist.pop_back();
+        waiting[splitter][col] = false;
+
+        // 3. Mark the states whose move on col leads into the splitter
+        std::vector<int> touched_blocks;
+        std::vector<int> marked_states;
+        marked_count.assign(blocks.size(), 0);
+        for(int target : blocks[splitter]) {
+          for(int state : predecessors[col][target]) {
+            if(marked[state]) {
               continue;
             }
 
-            // Given GOTO(Ii, a) = Ij, goto_indices maps "i,a" => j
-            std::string j = std::to_string(goto_indices.at(goto_key));
-            if(is_terminal(next_symbol)) {
-              table[state][symbol_cols[next_symbol]] = SHIFT_ACTION + j;
+            marked[state] = true;
+            marked_states.push_back(state);
+            if(marked_count[block_of[state]]++ == 0) {
+              touched_blocks.push_back(block_of[state]);
+            }
+          }
+        }
+
+        for(int block : touched_blocks) {
+          if(marked_count[block] == blocks[block].size()) {
+            continue;
+          }
+
+          // Split the marked states of block off into a new block
+          const int new_block = blocks.size();
+          std::vector<int> kept;
+          std::vector<int> split;
+          for(int state : blocks[block]) {
+            if(marked[state]) {
+              split.push_back(state);
+              block_of[state] = new_block;
             }
             else {
-              table[state][symbol_cols[next_symbol]] = j;
+              kept.push_back(state);
+            }
+          }
+          blocks[block] = std::move(kept);
+          blocks.push_back(std::move(split));
+          waiting.push_back(std::vector<bool>(col_count, false));
+
+          // 4. Keep the worklist covering both halves
+          const int smaller = blocks[block].size() <= blocks[new_block].size() ? block : new_block;
+          for(int c = 0; c < col_count; ++c) {
+            if(!has_moves[c]) {
+              continue;
+            }
+
+            const int add = waiting[block][c] ? new_block : smaller;
+            if(!waiting[add][c]) {
+              worklist.push_back({add, c});
+              waiting[add][c] = true;
             }
           }
         }
-        
-        ++state;
+
+        for(int state : marked_states) {
+          marked[state] = false;
+        }
       }
 
+      // Number the blocks, starting with the blocks of the start states
+      std::vector<int> block_numbers(blocks.size(), -1);
+      std::vector<int> state_map(state_count);
+      int count = 0;
+      for(int state = 0; state < start_count && state < state_count; ++state) {
+        block_numbers[block_of[state]] = count++;
+      }
+      for(int state = 0; state < state_count; ++state) {
+        int& number = block_numbers[block_of[state]];
+        if(number < 0) {
+          number = count++;
+        }
+        state_map[state] = number;
+      }
+
+      renumber_states(state_map);
+      return state_count - count;
+    }
+
+    /**
+     * Merges the columns of the cached table that are the same in every row
+     *
+     * Many terminals only ever appear in the same places, like 'BOOL',
+     * 'NUM' and 'STRING' in term_expression, so their columns hold the
+     * same actions in every state. Terminal and non-terminal columns are
+     * grouped separately into classes of equal columns, and the table
+     * keeps one column per class. Classes are ordered by their first
+     * column, except that the class of $ is the last terminal class, so
+     * the actions still come before the gotos.
+     *
+     * Each class is named by its symbols separated by spaces, like
+     * 'BOOL' 'NUM' 'STRING', and get_table_columns returns those names,
+     * which map every symbol to its column. See get_column_symbols and
+     * LexerGenerator::map_tokens, which gives a lexer the class ids.
+     *
+     * Should run after the other passes, which expect a column per symbol
+     * Returns the number of columns removed
+     */
+    int compress_columns() {
+      passes_run = true;
+      const int col_count = cols.size();
+      const int dollar_col = symbol_cols[DOLLAR];
+
+      // The columns in each class, terminal classes first
+      std::vector<std::vector<int>> classes;
+      int dollar_class = -1;
+      for(int section = 0; section < 2; ++section) {
+        const int first = section == 0 ? 0 : dollar_col + 1;
+        const int last = section == 0 ? dollar_col + 1 : col_count;
+
+        std::unordered_map<std::string, int> class_indices;
+        for(int col = first; col < last; ++col) {
+          std::string key;
+          for(const auto& row : table) {
+            key += row[col];
+            key += ',';
+          }
+
+          auto result = class_indices.emplace(std::move(key), classes.size());
+          if(result.second) {
+            classes.push_back({});
+          }
+          classes[result.first->second].push_back(col);
+
+          if(col == dollar_col) {
+            dollar_class = result.first->second;
+          }
+        }
+
+        // Move the class of $ after the other terminal classes
+        if(section == 0) {
+          std::vector<int> dollar_cols = std::move(classes[dollar_class]);
+          classes.erase(classes.begin() + dollar_class);
+          classes.push_back(std::move(dollar_cols));
+        }
+      }
+
+      for(auto& row : table) {
+        std::vector<std::string> compressed;
+        compressed.reserve(classes.size());
+        for(const std::vector<int>& members : classes) {
+          compressed.push_back(std::move(row[members[0]]));
+        }
+        row = std::move(compressed);
+      }
+
+      std::vector<std::string> class_names;
+      for(int i = 0; i < classes.size(); ++i) {
+        std::string name;
+        for(int col : classes[i]) {
+          name += (name.empty() ? "" : " ") + cols[col];
+          symbol_cols[cols[col]] = i;
+        }
+        class_names.push_back(std::move(name));
+      }
+      cols = std::move(class_names);
+
+      return col_count - cols.size();
+    }
+
+    /**
+     * Reorders the states and columns of the cached table so the cells
+     * a parser reads together sit close together in memory
+     *
+     * profile must have been recorded by LRParser on the table as it is
+     * now, i.e. built from the same grammar with the same passes.
+     *
+     * States: the start states keep their numbers. From the last state
+     * placed, the next state is the unplaced state the parser most often
+     * went to from it, or if there is none, the unplaced state it read
+     * most. So chains of states the parser runs through in a row end up
+     * next to each other. States the profile never reached go last in
+     * their original order.
+     *
+     * Columns: the terminals are ordered by how often they were read,
+     * with $ kept as the last terminal, and then the non-terminals the
+     * same way. So the hottest actions share the start of each row.
+     *
+     * Throws std::runtime_error if profile is for a table of another size
+     */
+    void order_by_profile(const ParseProfile& profile) {
+      passes_run = true;
+      const int state_count = table.size();
+      const int col_count = cols.size();
+      if(profile.get_state_count() != state_count || profile.get_col_count() != col_count) {
+        throw std::runtime_error("profile was recorded on a table with " + std::to_string(profile.get_state_count()) +
+          " states and " + std::to_string(profile.get_col_count()) + " columns, not " + std::to_string(state_count) +
+          " and " + std::to_string(col_count));
+      }
+
+      // States
+      const std::vector<uint64_t> state_counts = profile.get_state_counts();
+      std::vector<std::vector<std::pair<int, uint64_t>>> successors = profile.get_successors();
+      for(auto& next : successors) {
+        std::sort(next.begin(), next.end(), [](const std::pair<int, uint64_t>& a, const std::pair<int, uint64_t>& b) {
+          return a.second > b.second || (a.second == b.second && a.first < b.first);
+        });
+      }
+
+      std::vector<int> by_count;
+      for(int state = 0; state < state_count; ++state) {
+        if(state_counts[state] > 0) {
+          by_count.push_back(state);
+        }
+      }
+      std::stable_sort(by_count.begin(), by_count.end(), [&](int a, int b) {
+        return state_counts[a] > state_counts[b];
+      });
+
+      std::vector<int> state_map(state_count, -1);
+      int placed = 0;
+      for(int state = 0; state < get_start_count() && state < state_count; ++state) {
+        state_map[state] = placed++;
+      }
+
+      int current = 0;
+      size_t next_hottest = 0;
+      while(placed < state_count && state_count > 0) {
+        int next = -1;
+        for(const auto& successor : successors[current]) {
+          if(state_map[successor.first] < 0) {
+            next = successor.first;
+            break;
+          }
+        }
+
+        while(next < 0 && next_hottest < by_count.size()) {
+          if(state_map[by_count[next_hottest]] < 0) {
+            next = by_count[next_hottest];
+          }
+          ++next_hottest;
+        }
+
+        if(next < 0) {
+          break;
+        }
+
+        state_map[next] = placed++;
+        current = next;
+      }
+
+      for(int state = 0; state < state_count; ++state) {
+        if(state_map[state] < 0) {
+          state_map[state] = placed++;
+        }
+      }
+      renumber_states(state_map);
+
+      // Columns
+      const std::vector<uint64_t> col_counts = profile.get_col_counts();
+      const int dollar_col = symbol_cols[DOLLAR];
+      std::vector<int> col_order;
+      for(int col = 0; col < col_count; ++col) {
+        if(col != dollar_col) {
+          col_order.push_back(col);
+        }
+      }
+      auto hotter = [&](int a, int b) {
+        const bool a_terminal = a < dollar_col;
+        const bool b_terminal = b < dollar_col;
+        if(a_terminal != b_terminal) {
+          return a_terminal;
+        }
+        return col_counts[a] > col_counts[b];
+      };
+      std::stable_sort(col_order.begin(), col_order.end(), hotter);
+      col_order.insert(std::find_if(col_order.begin(), col_order.end(), [&](int col) { return col > dollar_col; }), dollar_col);
+
+      for(auto& row : table) {
+        std::vector<std::string> ordered;
+        ordered.reserve(col_count);
+        for(int col : col_order) {
+          ordered.push_back(std::move(row[col]));
+        }
+        row = std::move(ordered);
+      }
+
+      std::vector<int> col_map(col_count);
+      std::vector<std::string> ordered_cols;
+      for(int i = 0; i < col_count; ++i) {
+        col_map[col_order[i]] = i;
+        ordered_cols.push_back(cols[col_order[i]]);
+      }
+      for(auto& entry : symbol_cols) {
+        entry.second = col_map[entry.second];
+      }
+      cols = std::move(ordered_cols);
+    }
+
+    // Returns the cached table from build_parse_table or regenerate
+    const std::vector<std::vector<std::string>>& get_parse_table() const {
       return table;
-    };
+    }
+
+    /**
+     * Moves the cached table out of the generator for a caller that
+     * keeps it, leaving the cached table empty
+     * Table passes and regenerate need the cached table, so run them first
+     */
+    std::vector<std::vector<std::string>> release_parse_table() {
+      std::vector<std::vector<std::string>> released = std::move(table);
+      table.clear();
+      return released;
+    }
+
+    // Returns the grammar the table is built from
+    const std::shared_ptr<const Grammar>& get_grammar() const {
+      return grammar;
+    }
+
+    /**
+     * Returns the state to start parsing from for start_symbol,
+     * one of the symbols the grammar was augmented with
+     * Throws std::out_of_range if it is not a start symbol
+     */
+    int get_start_state(const std::string& start_symbol) const {
+      const int state = grammar->get_start_index(start_symbol);
+      if(state < 0) {
+        throw std::out_of_range(start_symbol + " is not a start symbol");
+      }
+
+      return state;
+    }
 
     // Returns the cached item_sets from the set generator
-    const std::set<std::set<LR1Item, LR1Comparator>, LR1SetComparator>& get_item_sets() {
+    // Sets moved out of memory are empty, see get_item_set
+    const std::vector<std::set<LR1Item, LR1Comparator>>& get_item_sets() const {
       return set_generator.get_item_sets();
     }
 
+    // Returns the item set of state, read back if it was moved out of memory
+    // See SetGenerator::get_item_set
+    const std::set<LR1Item, LR1Comparator>& get_item_set(int state) {
+      return set_generator.get_item_set(state);
+    }
+
+    // Returns the cached goto mappings from the set generator
+    // Gotos moved out of memory are not included, see get_gotos
+    const std::unordered_map<std::string, int>& get_goto_indices() const {
+      return set_generator.get_goto_indices();
+    }
+
+    // Returns the gotos of state as symbol, target state pairs
+    std::vector<std::pair<std::string, int>> get_gotos(int state) {
+      return set_generator.get_gotos(state);
+    }
+
     // Returns the symbols in the column order they appear in table
-    const std::vector<std::string>& get_table_columns() {
+    // After compress_columns each column is a class of symbols
+    const std::vector<std::string>& get_table_columns() const {
       return cols;
     }
 
+    // Returns the conflicts in the last built table that precedence
+    // did not resolve
+    ConflictCounts get_conflict_counts() const {
+      ConflictCounts total;
+      for(const auto& conflicts : row_conflicts) {
+        total += count_conflicts(conflicts);
+      }
+
+      return total;
+    }
+
+    // Returns the conflicts counted by get_conflict_counts by state
+    std::vector<Conflict> get_conflicts() const {
+      std::vector<Conflict> all;
+      for(const auto& conflicts : row_conflicts) {
+        all.insert(all.end(), conflicts.begin(), conflicts.end());
+      }
+
+      return all;
+    }
+
   private:
-    Grammar grammar;
+    std::shared_ptr<const Grammar> grammar;
     SetGenerator set_generator;
 
     /** 
@@ -137,6 +1166,413 @@ class LR1ParserTableGenerator {
     // The symbols in table in column order
     std::vector<std::string> cols;
 
+    // The conflicts fill_row resolved by default in each item set
+    std::vector<std::vector<Conflict>> row_conflicts;
+
+    // See set_abort_on_conflict
+    bool abort_on_conflict = false;
+
+    // See set_keep_conflicts
+    bool keep_conflicts = false;
+
+    // See set_try_slr
+    bool try_slr = false;
+
+    // True while table holds an SLR(1) table
+    bool slr = false;
+
+    // True once a table pass has renumbered or dropped rows of table,
+    // which then no longer line up with the item sets
+    bool passes_run = false;
+
+    /**
+     * Builds the SLR(1) table into table, Dragon book 4.6.4
+     *
+     * The same as build_parse_table but from the LR(0) item sets, and
+     * [A → α ⋅] reduces on every terminal in FOLLOW(A) (rule 2b)
+     *
+     * Returns false, with the table cleared, if an entry gets more than
+     * one action, i.e. the grammar is not SLR(1)
+     */
+    bool build_slr_table() {
+      set_generator.build_follow_sets();
+      set_generator.set_lr0(true);
+      slr = true;
+
+      // The LR(0) sets are no use once there is a conflict, so stop there
+      const bool complete = set_generator.build_item_sets_while([&](int state) {
+        table.emplace_back(symbol_cols.size());
+        if(fill_row(state, table[state])) {
+          return false;
+        }
+        set_generator.spill_finished_states(state);
+        return true;
+      });
+      set_generator.set_lr0(false);
+
+      if(!complete) {
+        slr = false;
+        table.clear();
+        row_conflicts.clear();
+        return false;
+      }
+
+      return true;
+    }
+
+    // Calls on_lookahead with each terminal the reduce item [A → α ⋅, t]
+    // reduces on, which is t, or FOLLOW(A) in an SLR(1) table
+    template<typename F>
+    void for_each_lookahead(const LR1Item& item, F on_lookahead) {
+      if(!slr) {
+        on_lookahead(item.get_lookahead());
+        return;
+      }
+
+      for(const std::string& lookahead : set_generator.get_follow_set(item.get_lhs())) {
+        on_lookahead(lookahead);
+      }
+    }
+
+    /**
+     * Fills row with the actions and gotos of state from the item set Istate
+     * 
+     * Assumes row has a column per symbol and the gotos of state are known
+     *
+     * Conflicts are resolved the way yacc does (Dragon book 4.8.1, 4.9.2)
+     * - reduce/reduce: the production that comes first in the grammar wins,
+     *   so the accept on $ wins over any reduce, which is a conflict too
+     * - shift/reduce: if both the production and the terminal have
+     *   a precedence, the higher one wins. On the same level %left reduces,
+     *   %right shifts and %nonassoc leaves an error entry. Otherwise the
+     *   shift wins.
+     * Conflicts that precedence doesn't settle are kept in row_conflicts,
+     * or thrown as a ConflictError with abort_on_conflict. With
+     * keep_conflicts their dropped actions are added to the entry after
+     * the chosen one. A shift/reduce conflict precedence settles drops
+     * any reduce the losing reduce won over as well.
+     *
+     * Only the columns get_conflict_columns finds go through the
+     * resolution, every other entry gets its one action straight away
+     *
+     * Returns true if any entry had more than one action,
+     * whether or not precedence resolved it
+     */
+    bool fill_row(int state, std::vector<std::string>& row) {
+      const std::set<LR1Item, LR1Comparator>& item_set = set_generator.get_item_set(state);
+      const std::unordered_map<std::string, int>& goto_indices = set_generator.get_goto_indices();
+
+      if(state >= row_conflicts.size()) {
+        row_conflicts.resize(state + 1);
+      }
+      std::vector<Conflict>& conflicts = row_conflicts[state];
+      conflicts.clear();
+
+      const std::vector<uint64_t> conflict_cols = get_conflict_columns(item_set);
+      auto may_conflict = [&](int col) {
+        return !conflict_cols.empty() && (conflict_cols[col / 64] >> (col % 64) & 1);
+      };
+
+      // The actions each entry dropped with keep_conflicts
+      std::unordered_map<int, std::vector<std::string>> dropped_actions;
+
+      auto add_conflict = [&](ConflictType type, int col, const std::string& chosen, const std::string& dropped) {
+        Conflict conflict;
+        conflict.type = type;
+        conflict.state = state;
+        conflict.symbol = cols[col];
+        conflict.chosen = chosen;
+        conflict.dropped = dropped;
+        if(abort_on_conflict && !slr) {
+          throw ConflictError(conflict, *grammar);
+        }
+        if(keep_conflicts) {
+          dropped_actions[col].push_back(conflict.dropped);
+        }
+        conflicts.push_back(std::move(conflict));
+      };
+
+      // Reductions go first so each shift is weighed against the
+      // reduction that won its column
+      // The production each reduce column holds
+      std::unordered_map<int, int> reductions;
+
+      // item_set == Ii
+      for(const auto& item : item_set) {
+        // The marker is to the right of the rhs
+        // item is [A → α ⋅, t] or [S' -> S ⋅, $]
+        std::string next_symbol = item.get_next_symbol();
+        if(next_symbol != EPSILON && !next_symbol.empty()) {
+          continue;
+        }
+
+        // The accept of [S' -> S ⋅, $] is weighed like a reduce by
+        // S' -> S, which comes before every other production
+        const int production = item.get_production_num();
+        const std::string reduce = item.is_augmented_production() ? ACCEPT_ACTION : REDUCE_ACTION + std::to_string(production);
+        auto add_reduce = [&](const std::string& lookahead) {
+          const int col = symbol_cols[lookahead];
+          if(!may_conflict(col)) {
+            row[col] = reduce;
+            return;
+          }
+
+          auto found = reductions.find(col);
+          if(found != reductions.end()) {
+            if(found->second == production) {
+              return;
+            }
+
+            if(found->second < production) {
+              add_conflict(ConflictType::REDUCE_REDUCE, col, row[col], reduce);
+              return;
+            }
+            add_conflict(ConflictType::REDUCE_REDUCE, col, reduce, row[col]);
+          }
+
+          reductions[col] = production;
+          row[col] = reduce;
+        };
+
+        if(item.is_augmented_production()) { //[S' -> S ⋅, $]
+          add_reduce(DOLLAR);
+        }
+        else {
+          for_each_lookahead(item, add_reduce);
+        }
+      }
+
+      // Columns a %nonassoc conflict turned into errors
+      std::unordered_set<int> error_cols;
+
+      for(const auto& item : item_set) {
+        // item is of the form [A → α ⋅ a B β, t]
+
+        // If item is [A → α ⋅ a β, t], next_symbol == a
+        std::string next_symbol = item.get_next_symbol();
+        if(next_symbol == EPSILON || next_symbol.empty()) {
+          continue;
+        }
+
+        // item is [A → α ⋅ a B β, t] or [A → α ⋅ A B β, t]
+        std::string goto_key = std::to_string(state) + "," + next_symbol;
+        if(goto_indices.count(goto_key) == 0) {
+          continue;
+        }
+
+        // Given GOTO(Ii, a) = Ij, goto_indices maps "i,a" => j
+        std::string j = std::to_string(goto_indices.at(goto_key));
+        const int col = symbol_cols[next_symbol];
+        if(!is_terminal(next_symbol)) {
+          row[col] = j;
+          continue;
+        }
+
+        const std::string shift = SHIFT_ACTION + j;
+        if(!may_conflict(col)) {
+          row[col] = shift;
+          continue;
+        }
+
+        if(row[col] == shift || error_cols.count(col) > 0) {
+          continue;
+        }
+
+        const auto found = reductions.find(col);
+        if(found != reductions.end()) {
+          const Precedence production = grammar->get_production_precedence(found->second);
+          const Precedence terminal = grammar->get_precedence(next_symbol);
+
+          if(production.empty() || terminal.empty()) {
+            add_conflict(ConflictType::SHIFT_REDUCE, col, shift, row[col]);
+          }
+          else if(production.level > terminal.level ||
+                  (production.level == terminal.level && terminal.associativity == Associativity::LEFT)) {
+            continue;
+          }
+          else if(production.level == terminal.level && terminal.associativity == Associativity::NONASSOC) {
+            row[col].clear();
+            error_cols.insert(col);
+            dropped_actions.erase(col);
+            continue;
+          }
+          else {
+            dropped_actions.erase(col);
+          }
+        }
+
+        row[col] = shift;
+      }
+
+      for(const auto& entry : dropped_actions) {
+        for(const std::string& action : entry.second) {
+          row[entry.first] += CONFLICT_SEP + action;
+        }
+      }
+
+      return !conflict_cols.empty();
+    }
+
+    /**
+     * Returns the terminal columns that more than one item of item_set
+     * wants an action in, as a bitset with a bit per column
+     *
+     * One pass over the items sets a bit per reduce lookahead and per
+     * shifted terminal. A column is a candidate if it is reduced on twice
+     * or both reduced and shifted on. Precedence may still resolve it.
+     * Returns an empty bitset if no column is, which is most states
+     */
+    std::vector<uint64_t> get_conflict_columns(const std::set<LR1Item, LR1Comparator>& item_set) {
+      const size_t words = symbol_cols[DOLLAR] / 64 + 1;
+      std::vector<uint64_t> reduces(words, 0), shifts(words, 0), conflicting(words, 0);
+
+      bool any = false;
+      for(const auto& item : item_set) {
+        const std::string next_symbol = item.get_next_symbol();
+        if(next_symbol == EPSILON || next_symbol.empty()) {
+          auto add_reduce = [&](const std::string& lookahead) {
+            const int col = symbol_cols[lookahead];
+            const uint64_t bit = 1ULL << (col % 64);
+            if(reduces[col / 64] & bit) {
+              conflicting[col / 64] |= bit;
+              any = true;
+            }
+            reduces[col / 64] |= bit;
+          };
+
+          // The accept is on $ like any reduce
+          if(item.is_augmented_production()) {
+            add_reduce(DOLLAR);
+          }
+          else {
+            for_each_lookahead(item, add_reduce);
+          }
+        }
+        else if(is_terminal(next_symbol)) {
+          const int col = symbol_cols[next_symbol];
+          shifts[col / 64] |= 1ULL << (col % 64);
+        }
+      }
+
+      for(size_t i = 0; i < words; ++i) {
+        conflicting[i] |= reduces[i] & shifts[i];
+        any = any || conflicting[i] != 0;
+      }
+
+      if(!any) {
+        conflicting.clear();
+      }
+      return conflicting;
+    }
+
+    // Returns the number of start symbols, whose start states
+    // are the first states of the table
+    int get_start_count() const {
+      return std::max<int>(grammar->get_start_symbols().size(), 1);
+    }
+
+    // Returns true if production n is a unit production like A -> B
+    // where B is a non-terminal
+    bool is_unit_production(int n) {
+      const Production& production = grammar->get_production(n);
+      return production.rhs.size() == 1 && !is_terminal(grammar->get_symbol(production.rhs[0]));
+    }
+
+    /**
+     * Drops the states of the cached table that can't be reached from
+     * a start state through a shift or goto and renumbers the rest in order
+     * 
+     * Returns the number of states dropped
+     */
+    int remove_unreachable_states() {
+      std::vector<bool> reachable(table.size(), false);
+      std::vector<int> stack;
+      for(int state = 0; state < get_start_count() && state < table.size(); ++state) {
+        reachable[state] = true;
+        stack.push_back(state);
+      }
+
+      while(!stack.empty()) {
+        int state = stack.back();
+        stack.pop_back();
+
+        for(const std::string& action : table[state]) {
+          if(!is_shift_action(action) && !is_goto_action(action)) {
+            continue;
+          }
+
+          int target = get_action_number(action);
+          if(!reachable[target]) {
+            reachable[target] = true;
+            stack.push_back(target);
+          }
+        }
+      }
+
+      std::vector<int> state_map(table.size(), -1);
+      int count = 0;
+      for(int state = 0; state < table.size(); ++state) {
+        if(reachable[state]) {
+          state_map[state] = count++;
+        }
+      }
+
+      int removed = table.size() - count;
+      if(removed > 0) {
+        renumber_states(state_map);
+      }
+
+      return removed;
+    }
+
+    /**
+     * Moves each row i of the cached table to row state_map[i] and
+     * rewrites the shift and goto targets to match
+     * 
+     * Rows mapped to -1 are dropped. If several rows map to the same
+     * state, the first one is kept.
+     */
+    void renumber_states(const std::vector<int>& state_map) {
+      int count = 0;
+      for(int state : state_map) {
+        count = std::max(count, state + 1);
+      }
+
+      std::vector<std::vector<std::string>> renumbered(count);
+      std::vector<bool> filled(count, false);
+      for(int state = 0; state < table.size(); ++state) {
+        int new_state = state_map[state];
+        if(new_state < 0 || filled[new_state]) {
+          continue;
+        }
+
+        renumbered[new_state] = remap_row(table[state], state_map);
+        filled[new_state] = true;
+      }
+
+      table = std::move(renumbered);
+    }
+
+    // Returns a copy of row with the state numbers of its shift
+    // and goto entries mapped through state_map
+    // {"s3", "r2", "4"} with state_map[3] = 5, state_map[4] = 1 gives {"s5", "r2", "1"}
+    // An entry that kept its conflict has at most one shift, which is first
+    static std::vector<std::string> remap_row(const std::vector<std::string>& row, const std::vector<int>& state_map) {
+      std::vector<std::string> remapped(row);
+
+      for(std::string& action : remapped) {
+        if(is_shift_action(action)) {
+          const size_t rest = std::min(action.find(CONFLICT_SEP), action.size());
+          action = SHIFT_ACTION + std::to_string(state_map[get_action_number(action)]) + action.substr(rest);
+        }
+        else if(is_goto_action(action)) {
+          action = std::to_string(state_map[get_action_number(action)]);
+        }
+      }
+
+      return remapped;
+    }
+
     // Initialize symbol_cols by mapping grammar symbols to their column indices in table
     void build_symbol_cols(const std::set<std::string>& terminals, const std::set<std::string>& non_terminals) {
       // Terminals will occupy 0...n - 1 table cols (action table)
@@ -159,8 +1595,8 @@ class LR1ParserTableGenerator {
       // Non-terminals will occupy n...m - 1 table cols (goto table)
       int m = 0;
       for(auto it = non_terminals.begin(); it != non_terminals.end(); ++it) {
-        // The augmented grammar symbol won't be in the parse table
-        if((*it) == AUGMENTED_LHS) {
+        // The augmented grammar symbols won't be in the parse table
+        if(is_augmented_symbol(*it)) {
           continue;
         }
         symbol_cols[(*it)] = m + n;
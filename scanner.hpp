@@ -0,0 +1,164 @@
+#ifndef _SCANNER_HPP_
+#define _SCANNER_HPP_
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Accept value of a DFA state that matches no token
+const static int NO_TOKEN = -1;
+
+// Accept value of a DFA state that matches text to skip, like whitespace
+const static int SKIP_TOKEN = -2;
+
+/**
+ * The tables of a minimized lexer DFA
+ *
+ * Bytes are first mapped to their class, and the DFA moves on classes
+ * instead of bytes. Bytes that every token treats the same share a class,
+ * which keeps the transition table small.
+ *
+ * Token ids are the columns of the terminals in the parse table,
+ * and end_token is the column of $
+ */
+struct LexerTables {
+  // The class of each byte
+  std::vector<int> byte_classes = std::vector<int>(256, 0);
+
+  int class_count = 0;
+
+  // transitions[state * class_count + class] is the next state or -1
+  std::vector<int> transitions;
+
+  // The token accepted in each state, NO_TOKEN or SKIP_TOKEN
+  std::vector<int> accepts;
+
+  // The terminal of each token id
+  std::vector<std::string> token_names;
+
+  int end_token = NO_TOKEN;
+
+  size_t state_count() const {
+    return accepts.size();
+  }
+};
+
+/**
+ * Thrown when no token matches the input at position
+ */
+class ScanError : public std::runtime_error {
+  public:
+    ScanError(size_t position) :
+      std::runtime_error("no token matches the input at byte " + std::to_string(position)),
+      position(position) {}
+
+    size_t get_position() const {
+      return position;
+    }
+
+  private:
+    size_t position;
+};
+
+/**
+ * Splits input into tokens with the tables of a lexer DFA
+ *
+ * The DFA is run from the start state, state 0, for as long as it has a
+ * move, and the last accepting state it passed decides the token. So the
+ * longest match wins, and ties go to the definition that came first.
+ *
+ * The tables are only read, so a scanner can be shared by several threads.
+ */
+class Scanner {
+  public:
+    Scanner(const LexerTables& tables) : tables(tables) {}
+
+    /**
+     * Finds the longest token starting at data[position]
+     * Sets length to the number of bytes it covers
+     *
+     * Returns its token id, SKIP_TOKEN for skipped text,
+     * or NO_TOKEN if nothing matches
+     */
+    int next_token(const char* data, size_t size, size_t position, size_t& length) const {
+      size_t scanned;
+      return next_token(data, size, position, length, scanned);
+    }
+
+    /**
+     * Same as above, and sets scanned to the number of bytes the DFA read
+     * to decide on the token, which may be more than its length
+     * Running into the end of data counts as reading one more byte,
+     * since appending to data could change the token
+     */
+    int next_token(const char* data, size_t size, size_t position, size_t& length, size_t& scanned) const {
+      const int* transitions = tables.transitions.data();
+      const int* byte_classes = tables.byte_classes.data();
+      const int class_count = tables.class_count;
+
+      int token = NO_TOKEN;
+      length = 0;
+
+      int state = 0;
+      size_t i = position;
+      for(; i < size; ++i) {
+        state = transitions[state * class_count + byte_classes[(unsigned char)data[i]]];
+        if(state < 0) {
+          break;
+        }
+
+        if(tables.accepts[state] != NO_TOKEN) {
+          token = tables.accepts[state];
+          length = i + 1 - position;
+        }
+      }
+      scanned = i + 1 - position;
+
+      return token;
+    }
+
+    /**
+     * Returns the ids of the tokens in data, without skipped text
+     * and ending with end_token
+     *
+     * Throws ScanError at the first byte no token matches
+     */
+    std::vector<int> tokenize(const char* data, size_t size) const {
+      std::vector<int> tokens;
+      tokenize(data, size, tokens);
+      return tokens;
+    }
+
+    std::vector<int> tokenize(const std::string& input) const {
+      return tokenize(input.data(), input.size());
+    }
+
+    /**
+     * Same as above into tokens, which is cleared first, so a caller
+     * that scans many inputs can reuse one vector
+     */
+    void tokenize(const char* data, size_t size, std::vector<int>& tokens) const {
+      tokens.clear();
+
+      size_t position = 0;
+      while(position < size) {
+        size_t length;
+        const int token = next_token(data, size, position, length);
+        if(token == NO_TOKEN || length == 0) {
+          throw ScanError(position);
+        }
+
+        if(token != SKIP_TOKEN) {
+          tokens.push_back(token);
+        }
+        position += length;
+      }
+
+      tokens.push_back(tables.end_token);
+    }
+
+  private:
+    const LexerTables& tables;
+};
+
+#endif /* _SCANNER_HPP_ */
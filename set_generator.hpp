@@ -6,25 +6,36 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <queue>
+#include <algorithm>
+#include <functional>
+#include <memory>
 
 #include "lr1_item.hpp"
 #include "grammar.hpp"
+#include "state_store.hpp"
 
 /**
  * Generates LR(1) first, goto, closure, and item sets for a grammar
- * 
+ *
+ * With set_lr0, the item sets are LR(0) sets instead, whose items all
+ * have an empty lookahead. FOLLOW sets then give the reduce lookaheads.
+ *
+ * With a memory budget, finished item sets and their gotos are moved
+ * out to a StateStore once the sets in memory go over the budget.
+ * Only the small kernel keys that find existing states stay in memory
+ * for every state. See spill_finished_states
  */ 
 class SetGenerator {
   public:
-    SetGenerator(Grammar grammar) : grammar(grammar) {}
+    SetGenerator(std::shared_ptr<const Grammar> grammar) : grammar(std::move(grammar)) {}
 
     // Calculates the first sets for each symbol in the grammar
-    // Returns a map of symbol => { '(', '+', ...}
-    std::unordered_map<std::string, std::unordered_set<std::string>> build_first_sets() {
+    // Returns the cached map of symbol => { '(', '+', ...}
+    const std::unordered_map<std::string, std::unordered_set<std::string>>& build_first_sets() {
       // Remove any previous sets
       first_sets.clear();
 
-      for(const auto& symbol : grammar.get_all_symbols()) {
+      for(const auto& symbol : grammar->get_all_symbols()) {
         first_of(symbol);
       }
 
@@ -37,6 +48,85 @@ class SetGenerator {
       return first_sets;
     }
 
+    /**
+     * Calculates the FOLLOW sets of the non-terminals from the first sets
+     * Returns the cached map of symbol => { '$', ')', ...}
+     *
+     * Rules from Dragon book 4.4.2
+     * 1. Place $ in FOLLOW(S) for each start symbol S, here the lhs of
+     *    the augmented productions
+     * 2. If there is a production A → α B β, everything in FIRST(β)
+     *    except ε is in FOLLOW(B)
+     * 3. If there is a production A → α B, or A → α B β where FIRST(β)
+     *    contains ε, everything in FOLLOW(A) is in FOLLOW(B)
+     * Rules 2 and 3 are applied until no FOLLOW set grows
+     */
+    const std::unordered_map<std::string, std::unordered_set<std::string>>& build_follow_sets() {
+      follow_sets.clear();
+
+      for(size_t i = 0; i < grammar->size(); ++i) {
+        const std::string& lhs = grammar->get_symbol(grammar->get_production(i).lhs);
+        if(is_augmented_symbol(lhs)) {
+          follow_sets[lhs].insert(DOLLAR);
+        }
+      }
+
+      bool changed = true;
+      while(changed) {
+        changed = false;
+
+        for(size_t i = 0; i < grammar->size(); ++i) {
+          const Production& production = grammar->get_production(i);
+          const std::string& lhs = grammar->get_symbol(production.lhs);
+
+          std::vector<std::string> rhs;
+          for(int symbol : production.rhs) {
+            rhs.push_back(grammar->get_symbol(symbol));
+          }
+
+          for(size_t j = 0; j < rhs.size(); ++j) {
+            const std::string& b = rhs[j];
+            if(is_terminal(b) || b == EPSILON) {
+              continue;
+            }
+
+            std::unordered_set<std::string> beta_first = first(std::vector<std::string>(rhs.begin() + j + 1, rhs.end()));
+            std::unordered_set<std::string>& follow = follow_sets[b];
+            const size_t size = follow.size();
+
+            if(beta_first.erase(EPSILON) > 0) {
+              // Copied, since follow may be FOLLOW(A) itself
+              const std::unordered_set<std::string> lhs_follow = follow_sets[lhs];
+              follow.insert(lhs_follow.begin(), lhs_follow.end());
+            }
+            follow.insert(beta_first.begin(), beta_first.end());
+
+            changed = changed || follow.size() != size;
+          }
+        }
+      }
+
+      return follow_sets;
+    }
+
+    // Returns FOLLOW(symbol) from build_follow_sets
+    const std::unordered_set<std::string>& get_follow_set(const std::string& symbol) const {
+      const static std::unordered_set<std::string> empty;
+      const auto found = follow_sets.find(symbol);
+      return found != follow_sets.end() ? found->second : empty;
+    }
+
+    /**
+     * Makes the next collection of item sets LR(0) instead of LR(1)
+     *
+     * The items get an empty lookahead and closure adds [B → ⋅ γ] once,
+     * so sets that only differ in lookaheads are one state.
+     * Dragon book 4.6.2
+     */
+    void set_lr0(bool lr0) {
+      this->lr0 = lr0;
+    }
+
     /**
      * Builds the closure set for the items in s
      * 
@@ -45,6 +135,8 @@ class SetGenerator {
      *   For each production B → γ in G,
      *     For each token b in FIRST(βt),
      *       Add [B → ⋅ γ, b] to S
+     *
+     * For LR(0) sets there are no lookaheads, so [B → ⋅ γ] is added once
      */
     std::set<LR1Item, LR1Comparator> build_closure_set(const std::set<LR1Item, LR1Comparator>& s) {
       std::queue<LR1Item> q;
@@ -60,16 +152,25 @@ class SetGenerator {
         const LR1Item item = q.front(); 
         q.pop();
 
-        if(item.next_is_non_terminal()) {
+        if(item.next_is_non_terminal() && lr0) {
+          // For each production B → γ in G, add [B → ⋅ γ] to S
+          for(int pi : get_production_indices(item.get_next_symbol())) {
+            LR1Item closure_item((*grammar)[pi], pi, "", 0);
+            if(closure.insert(closure_item).second) {
+              q.push(closure_item);
+            }
+          }
+        }
+        else if(item.next_is_non_terminal()) {
           std::string B = item.get_next_symbol();
           std::vector<std::string> beta_t = item.get_beta_symbols();
           std::string t = item.get_lookahead();
           beta_t.push_back(t);
 
-          std::vector<int> production_indices = get_production_indices(B);
+          const std::vector<int>& production_indices = get_production_indices(B);
           std::unordered_set<std::string> first_tokens = first(beta_t); // FIRST(βt)
           for(int pi : production_indices) { // For each production B → γ in G
-            const std::string& production = grammar[pi];
+            const std::string& production = (*grammar)[pi];
 
             // For each token b in FIRST(βt)
             for(std::string b : first_tokens) {
@@ -92,7 +193,7 @@ class SetGenerator {
     std::set<LR1Item, LR1Comparator> build_initial_closure() {
       // Create set with augmented item
       std::set<LR1Item, LR1Comparator> s;
-      s.insert(LR1Item(grammar[0], 0, DOLLAR, 0));
+      s.insert(LR1Item((*grammar)[0], 0, DOLLAR, 0));
 
       // Build closure from augmented item
       std::set<LR1Item, LR1Comparator> closure = build_closure_set(s);
@@ -134,85 +235,367 @@ class SetGenerator {
      *      for each grammar symbol X
      *        if GOTO(I,X) not empty and not in C
      *          add GOTO(I,X) to C
+     *
+     * C is walked breadth first. Each set is numbered in the order
+     * it is discovered and keeps that number, so I0 is always the
+     * initial closure and item_sets[i] == Ii.
+     */
+    const std::vector<std::set<LR1Item, LR1Comparator>>& build_item_sets() {
+      build_item_sets(nullptr);
+      return item_sets;
+    }
+
+    /**
+     * Builds all item sets as above and calls on_state_done with each
+     * state number as soon as its gotos are known
+     *
+     * States are finished in order, so rows can be generated from
+     * Ii and goto_indices while later sets are still being built
+     */
+    void build_item_sets(const std::function<void(int)>& on_state_done) {
+      build_item_sets_while([&](int i) {
+        if(on_state_done) {
+          on_state_done(i);
+        }
+        return true;
+      });
+    }
+
+    /**
+     * Builds item sets as above until on_state_done returns false
+     *
+     * Returns false if it stopped early, in which case the collection
+     * is unfinished and only good for starting over
+     */
+    bool build_item_sets_while(const std::function<bool(int)>& on_state_done) {
+      begin_item_sets();
+
+      // for each set i in c
+      // Sets added while walking c are appended and visited in turn
+      for(int i = 0; i < item_sets.size(); ++i) {
+        expand_item_set(i);
+
+        if(!on_state_done(i)) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    /**
+     * Starts a new collection holding only I0, the closure of the
+     * augmented item, or one initial closure per start symbol
+     *
+     * Use expand_item_set to add the sets reachable from it one state
+     * at a time, e.g. only as a parser reaches them
      */
-    std::set<std::set<LR1Item, LR1Comparator>, LR1SetComparator> build_item_sets() {
+    void begin_item_sets() {
+      // Remove any previous sets
+      item_sets.clear();
+      item_set_indices.clear();
+      goto_indices.clear();
+      spilled_offsets.clear();
+      item_set_bytes.clear();
+      resident_bytes = 0;
+      spilled_count = 0;
+      next_spill = 0;
+      loaded_state = -1;
+      store.reset();
+
       // init c to {closure(augmented_item)}
-      std::set<LR1Item, LR1Comparator> i0 = build_initial_closure();
-      item_sets = {i0};
-
-      // Track the gotos we have already done so we don't
-      // duplicate sets in c
-      //
-      // If all items in the kernel set exist in completed_gotos
-      // skip GOTO(I,X)
-      // Otherwise
-      // add them and compute GOTO(I,X)
-      std::set<LR1Item, LR1Comparator> completed_gotos;
-
-      int prev_size = 0;
-      while(true) {
-        // The current set number
-        int i = 0;
-
-        // for each set i in c
-        for(const std::set<LR1Item, LR1Comparator>& Ii : item_sets) {
-          // for each grammar symbol X
-          for(auto it = first_sets.begin(); it != first_sets.end(); ++it) {
-            std::string x = (*it).first;
-            std::set<LR1Item, LR1Comparator> gotos = build_goto(Ii, x);
-            // if GOTO(I,X) not empty
-            if(!gotos.empty()) {
-              // The goto mapping key
-              std::string goto_key = std::to_string(i) + "," + x;
-              // add GOTO(I,X) to c
-              // c is a set so GOTO will only be added
-              // if it is not in c already
-              auto result = item_sets.insert(gotos);
-              if(result.second) { // gotos wasn't in c
-                goto_indices[goto_key] = item_sets.size() - 1;
-              }
-              else { // gotos was in c
-                goto_indices[goto_key] = std::distance(item_sets.begin(), result.first);
-              }
+      // With several start symbols there is an augmented item for each,
+      // and Ii is the initial closure of start symbol i
+      const size_t start_count = std::max<size_t>(grammar->get_start_symbols().size(), 1);
+      for(size_t i = 0; i < start_count; ++i) {
+        std::set<LR1Item, LR1Comparator> augmented_item;
+        augmented_item.insert(LR1Item((*grammar)[i], i, lr0 ? "" : DOLLAR, 0));
+        add_item_set(augmented_item);
+      }
+    }
+
+    /**
+     * Computes GOTO(Ii, X) for each grammar symbol X of state i
+     * Sets that are new are closed and appended to item_sets but
+     * are not expanded themselves
+     */
+    void expand_item_set(int i) {
+      // for each grammar symbol X that follows a marker in Ii
+      // Any other X would give an empty GOTO(I,X)
+      for(const std::string& x : get_next_symbols(item_sets[i])) {
+        // The goto mapping key
+        std::string goto_key = std::to_string(i) + "," + x;
+
+        // add GOTO(I,X) to c if it is not in c already
+        goto_indices[goto_key] = add_item_set(get_kernel_items(item_sets[i], x));
+      }
+    }
+
+    /**
+     * Sets the bytes the item sets in memory may take up before
+     * spill_finished_states moves them out, or 0 for no limit
+     *
+     * The size of a set is an estimate of its items and their strings
+     */
+    void set_memory_budget(size_t bytes) {
+      memory_budget = bytes;
+    }
+
+    /**
+     * Moves finished sets out of memory, oldest first, for as long as
+     * the sets in memory are over the memory budget
+     *
+     * States up to last_state must be finished, i.e. expanded and done
+     * with by the caller. Later states are still to be expanded and are
+     * never moved. A set that is moved out can still be read with
+     * get_item_set and get_gotos, only slower.
+     *
+     * Throws std::runtime_error if the store can't be written
+     */
+    void spill_finished_states(int last_state) {
+      if(memory_budget == 0) {
+        return;
+      }
+
+      for(; next_spill <= last_state && resident_bytes > memory_budget; ++next_spill) {
+        spill_item_set(next_spill);
+      }
+    }
+
+    // Returns the number of sets that have been moved out of memory
+    size_t get_spilled_count() const {
+      return spilled_count;
+    }
+
+    /**
+     * Returns the set of state, reading it back if it was moved out
+     * A set that was read back is only valid until the next call
+     */
+    const std::set<LR1Item, LR1Comparator>& get_item_set(int state) {
+      if(spilled_offsets[state] < 0) {
+        return item_sets[state];
+      }
+
+      read_spilled_state(state);
+      return loaded_set;
+    }
+
+    /**
+     * Returns the symbols with a goto from state and the states
+     * they lead to, reading them back if they were moved out
+     */
+    std::vector<std::pair<std::string, int>> get_gotos(int state) {
+      if(spilled_offsets[state] >= 0) {
+        read_spilled_state(state);
+        return loaded_gotos;
+      }
+
+      std::vector<std::pair<std::string, int>> gotos;
+      for(const std::string& x : get_next_symbols(item_sets[state])) {
+        const auto found = goto_indices.find(std::to_string(state) + "," + x);
+        if(found != goto_indices.end()) {
+          gotos.emplace_back(x, found->second);
+        }
+      }
+
+      return gotos;
+    }
+
+    // Returns the number of item sets found so far
+    size_t get_state_count() const {
+      return item_sets.size();
+    }
+
+    /**
+     * Replaces the grammar with new_grammar, an edited version of the
+     * current grammar, and recalculates the first sets
+     *
+     * Productions are compared by index. If production i differs between
+     * the two grammars, the lhs of both versions is affected.
+     *
+     * Returns the affected symbols along with every symbol whose
+     * FIRST set changed
+     */
+    std::unordered_set<std::string> update_grammar(std::shared_ptr<const Grammar> new_grammar) {
+      std::unordered_set<std::string> affected;
+
+      size_t size = std::max(grammar->size(), new_grammar->size());
+      for(size_t i = 0; i < size; ++i) {
+        const bool in_old = i < grammar->size();
+        const bool in_new = i < new_grammar->size();
+
+        if(in_old && in_new && (*grammar)[i] == (*new_grammar)[i]) {
+          continue;
+        }
+
+        if(in_old) {
+          affected.insert(get_LHS((*grammar)[i]));
+        }
+        if(in_new) {
+          affected.insert(get_LHS((*new_grammar)[i]));
+        }
+      }
+
+      std::unordered_map<std::string, std::unordered_set<std::string>> old_first_sets = std::move(first_sets);
+      grammar = std::move(new_grammar);
+      build_first_sets();
+
+      for(const auto& entry : first_sets) {
+        const auto found = old_first_sets.find(entry.first);
+        if(found == old_first_sets.end() || found->second != entry.second) {
+          affected.insert(entry.first);
+        }
+      }
+
+      for(const auto& entry : old_first_sets) {
+        if(first_sets.count(entry.first) == 0) {
+          affected.insert(entry.first);
+        }
+      }
+
+      return affected;
+    }
+
+    /**
+     * Determines which of the cached item sets are unchanged by an edit
+     * that affects the given symbols
+     *
+     * The closure of a kernel only expands the non-terminals to the right
+     * of a marker, using their productions and the FIRST sets of the
+     * symbols after them. So set i can be reused as long as none of its
+     * items belong to an affected lhs and no symbol at or after a marker
+     * is affected.
+     */
+    std::vector<bool> get_reusable_sets(const std::unordered_set<std::string>& affected) {
+      std::vector<bool> reusable(item_sets.size(), true);
+
+      for(int i = 0; i < item_sets.size(); ++i) {
+        for(const LR1Item& item : item_sets[i]) {
+          if(affected.count(item.get_lhs()) > 0 || affected.count(item.get_next_symbol()) > 0) {
+            reusable[i] = false;
+            break;
+          }
+
+          for(const std::string& symbol : item.get_beta_symbols()) {
+            if(affected.count(symbol) > 0) {
+              reusable[i] = false;
+              break;
             }
           }
 
-          ++i;
+          if(!reusable[i]) {
+            break;
+          }
         }
+      }
 
-        // Break if c hasn't changed
-        if(prev_size == item_sets.size()) {
-          break;
+      return reusable;
+    }
+
+    /**
+     * Rebuilds the item sets after update_grammar
+     *
+     * Walks the collection exactly as build_item_sets does, so states
+     * are numbered as they would be by a full build. Where a kernel
+     * matches a previous set i with reusable[i] set, that set is taken
+     * as is instead of recomputing its closure.
+     *
+     * Returns a vector mapping each previous state number to the new
+     * number of the state with the same kernel, or -1 if there is none
+     */
+    std::vector<int> rebuild_item_sets(const std::vector<bool>& reusable) {
+      std::vector<std::string> previous_kernels(item_sets.size());
+
+      for(int i = 0; i < item_sets.size(); ++i) {
+        previous_kernels[i] = get_kernel_key(get_kernel_items(item_sets[i]));
+
+        if(reusable[i]) {
+          reusable_sets.emplace(previous_kernels[i], std::move(item_sets[i]));
         }
-        prev_size = item_sets.size();
       }
 
-      return item_sets;
+      build_item_sets();
+      reusable_sets.clear();
+
+      std::vector<int> previous_to_new(previous_kernels.size(), -1);
+      for(int i = 0; i < previous_kernels.size(); ++i) {
+        const auto found = item_set_indices.find(previous_kernels[i]);
+        if(found != item_set_indices.end()) {
+          previous_to_new[i] = found->second;
+        }
+      }
+
+      return previous_to_new;
     }
 
     // Return the cached goto_indices
-    const std::unordered_map<std::string, int>& get_goto_indices() {
+    // The gotos of states moved out of memory are not included, see get_gotos
+    const std::unordered_map<std::string, int>& get_goto_indices() const {
       return goto_indices;
     }
 
     // Return the cached item_sets
-    const std::set<std::set<LR1Item, LR1Comparator>, LR1SetComparator>& get_item_sets() {
+    // item_sets[i] is the set for state i
+    // Sets moved out of memory are left empty, see get_item_set
+    const std::vector<std::set<LR1Item, LR1Comparator>>& get_item_sets() const {
       return item_sets;
     }
 
   private:
-    // The provided grammar
-    Grammar grammar;
+    // The provided grammar, shared with the table generator
+    std::shared_ptr<const Grammar> grammar;
 
     // Holds the FIRST(X) sets for each grammar item X
     std::unordered_map<std::string, std::unordered_set<std::string>> first_sets;
 
+    // Holds the FOLLOW(A) sets for each non-terminal A
+    std::unordered_map<std::string, std::unordered_set<std::string>> follow_sets;
+
+    // Build LR(0) item sets, see set_lr0
+    bool lr0 = false;
+
     // Holds the item sets calculated in build_item_sets
-    std::set<std::set<LR1Item, LR1Comparator>, LR1SetComparator> item_sets;
+    // Indexed by state number in discovery order
+    std::vector<std::set<LR1Item, LR1Comparator>> item_sets;
+
+    // Maps the key of the kernel of each set in item_sets to its state number
+    // Closure only adds non-kernel items so the kernel identifies the set
+    // Kept in memory for every state, spilled or not
+    std::unordered_map<std::string, int> item_set_indices;
+
+    // Closed item sets kept from before update_grammar, keyed by the
+    // key of their kernel
+    // Used by rebuild_item_sets in place of computing the closure again
+    std::unordered_map<std::string, std::set<LR1Item, LR1Comparator>> reusable_sets;
 
     // Holds mappings of the form "<input set index>,<input symbol>" => "<output set index>"
     std::unordered_map<std::string, int> goto_indices;
 
+    // Bytes the sets in memory may take up, or 0 for no limit
+    size_t memory_budget = 0;
+
+    // Holds the sets moved out of memory, created by the first spill
+    std::unique_ptr<StateStore> store;
+
+    // The offset in store of each set, or -1 while it is in memory
+    std::vector<int64_t> spilled_offsets;
+
+    // The estimated size of each set while it is in memory
+    std::vector<size_t> item_set_bytes;
+
+    // The estimated size of all the sets in memory
+    size_t resident_bytes = 0;
+
+    size_t spilled_count = 0;
+
+    // The oldest state that may still be in memory
+    int next_spill = 0;
+
+    // The last spilled state read back by get_item_set or get_gotos
+    int loaded_state = -1;
+    std::set<LR1Item, LR1Comparator> loaded_set;
+    std::vector<std::pair<std::string, int>> loaded_gotos;
+
   private:
     /**
      * Calculates the first set of the given symbol
@@ -243,9 +626,9 @@ class SetGenerator {
         return;
       }
 
-      std::vector<int> production_indices = get_production_indices(symbol);
+      const std::vector<int>& production_indices = get_production_indices(symbol);
       for(int pi : production_indices) {
-        const std::string& production = grammar[pi];
+        const std::string& production = (*grammar)[pi];
         std::vector<std::string> rhs = Grammar::extract_symbols(get_RHS(production));
 
         // If there is a Production X → ε then add ε to first(X)
@@ -337,18 +720,187 @@ class SetGenerator {
       * 
       * when given A will return ['A -> B', 'A -> d']
       */
-    std::vector<int> get_production_indices(const std::string& symbol) {
-      std::vector<int> ret;
+    const std::vector<int>& get_production_indices(const std::string& symbol) {
+      return grammar->get_production_indices(symbol);
+    }
 
-      for(int i = 0; i < grammar.size(); ++i) {
-        const std::string& production = grammar[i];
+    /**
+     * Returns the state number of the set with the given kernel items,
+     * closing the kernel and adding it to the end of item_sets if
+     * it has not been seen before
+     */
+    int add_item_set(const std::set<LR1Item, LR1Comparator>& kernel) {
+      std::string key = get_kernel_key(kernel);
 
-        if(get_LHS(production) == symbol) {
-          ret.push_back(i);
+      const auto found = item_set_indices.find(key);
+      if(found != item_set_indices.end()) {
+        return found->second;
+      }
+
+      int index = item_sets.size();
+
+      const auto reusable = reusable_sets.find(key);
+      if(reusable != reusable_sets.end()) {
+        item_sets.push_back(std::move(reusable->second));
+        reusable_sets.erase(reusable);
+      }
+      else {
+        std::set<LR1Item, LR1Comparator> item_set = kernel;
+        std::set<LR1Item, LR1Comparator> closure = build_closure_set(kernel);
+        item_set.merge(closure);
+        item_sets.push_back(std::move(item_set));
+      }
+
+      const size_t bytes = estimate_item_set_bytes(item_sets.back());
+      item_set_bytes.push_back(bytes);
+      resident_bytes += bytes;
+      spilled_offsets.push_back(-1);
+
+      item_set_indices.emplace(std::move(key), index);
+      return index;
+    }
+
+    /**
+     * Builds a compact string that identifies the set with the given kernel
+     * Each item is written as its production number, marker position
+     * and lookahead, which is far smaller than the item text
+     */
+    static std::string get_kernel_key(const std::set<LR1Item, LR1Comparator>& kernel) {
+      std::string key;
+      for(const LR1Item& item : kernel) {
+        put_varint(key, item.get_production_num());
+        put_varint(key, item.get_position());
+        key += item.get_lookahead();
+        key += '\0';
+      }
+
+      return key;
+    }
+
+    // Estimates the bytes item_set takes up, counting each tree node
+    // and what its item holds on the heap
+    static size_t estimate_item_set_bytes(const std::set<LR1Item, LR1Comparator>& item_set) {
+      // Color and parent, left and right links
+      const size_t node_bytes = 4 * sizeof(void*) + sizeof(LR1Item);
+
+      size_t bytes = sizeof(item_set);
+      for(const LR1Item& item : item_set) {
+        bytes += node_bytes + item.get_heap_bytes();
+      }
+
+      return bytes;
+    }
+
+    /**
+     * Appends the set of state and its gotos to the store and frees them
+     *
+     * Record layout, with every integer written as an unsigned LEB128 varint
+     *
+     * items:  count, then the production_num, position,
+     *         lookahead length and lookahead of each item
+     * gotos:  count, then the symbol length, symbol and
+     *         target state of each goto
+     */
+    void spill_item_set(int state) {
+      if(spilled_offsets[state] >= 0) {
+        return;
+      }
+
+      if(!store) {
+        store.reset(new StateStore());
+      }
+
+      std::set<LR1Item, LR1Comparator>& item_set = item_sets[state];
+      std::vector<std::pair<std::string, int>> gotos = get_gotos(state);
+
+      std::string record;
+      put_varint(record, item_set.size());
+      for(const LR1Item& item : item_set) {
+        const std::string lookahead = item.get_lookahead();
+        put_varint(record, item.get_production_num());
+        put_varint(record, item.get_position());
+        put_varint(record, lookahead.size());
+        record += lookahead;
+      }
+
+      put_varint(record, gotos.size());
+      for(const auto& entry : gotos) {
+        put_varint(record, entry.first.size());
+        record += entry.first;
+        put_varint(record, entry.second);
+        goto_indices.erase(std::to_string(state) + "," + entry.first);
+      }
+
+      spilled_offsets[state] = store->append(record);
+      std::set<LR1Item, LR1Comparator>().swap(item_set);
+      resident_bytes -= item_set_bytes[state];
+      item_set_bytes[state] = 0;
+      ++spilled_count;
+    }
+
+    // Reads the set and gotos of a spilled state back
+    // into loaded_set and loaded_gotos
+    void read_spilled_state(int state) {
+      if(loaded_state == state && store) {
+        return;
+      }
+
+      const char* data;
+      size_t size;
+      store->read(spilled_offsets[state], data, size);
+
+      size_t pos = 0;
+      bool ok = true;
+      auto next = [&]() {
+        uint64_t value = 0;
+        ok = ok && get_varint(data, size, pos, value);
+        return ok ? value : 0;
+      };
+      auto next_str = [&]() {
+        const uint64_t length = next();
+        ok = ok && pos + length <= size;
+        std::string str = ok ? std::string(data + pos, length) : std::string();
+        pos += ok ? length : 0;
+        return str;
+      };
+
+      loaded_set.clear();
+      loaded_gotos.clear();
+
+      for(uint64_t count = next(); ok && count > 0; --count) {
+        const int production_num = next();
+        const int position = next();
+        const std::string lookahead = next_str();
+        if(ok) {
+          loaded_set.insert(LR1Item((*grammar)[production_num], production_num, lookahead, position));
         }
       }
 
-      return ret;
+      for(uint64_t count = next(); ok && count > 0; --count) {
+        std::string symbol = next_str();
+        const int target = next();
+        loaded_gotos.emplace_back(std::move(symbol), target);
+      }
+
+      if(!ok) {
+        loaded_state = -1;
+        throw std::runtime_error("corrupt state store record for state " + std::to_string(state));
+      }
+      loaded_state = state;
+    }
+
+    // Returns the symbols to the right of the marker in each item of item_set
+    // S -> A . B and S -> . A B gives {A, B}
+    static std::set<std::string> get_next_symbols(const std::set<LR1Item, LR1Comparator>& item_set) {
+      std::set<std::string> symbols;
+      for(const LR1Item& item : item_set) {
+        std::string symbol = item.get_next_symbol();
+        if(!symbol.empty() && symbol != EPSILON) {
+          symbols.insert(symbol);
+        }
+      }
+
+      return symbols;
     }
 
     /**
@@ -360,7 +912,7 @@ class SetGenerator {
      * They are the items in the goto set before the closure items are added
      * 
      */
-    std::set<LR1Item, LR1Comparator> get_kernel_items(const std::set<LR1Item, LR1Comparator>& item_set, const std::string& symbol) {
+    std::set<LR1Item, LR1Comparator> get_kernel_items(const std::set<LR1Item, LR1Comparator>& item_set, const std::string& symbol) const {
       std::set<LR1Item, LR1Comparator> kernel_items;
 
       // for each item in I
@@ -376,6 +928,20 @@ class SetGenerator {
 
       return kernel_items;
     }
+
+    // Gets the kernel items of item_set itself
+    // i.e. the items that were not added by its closure
+    std::set<LR1Item, LR1Comparator> get_kernel_items(const std::set<LR1Item, LR1Comparator>& item_set) const {
+      std::set<LR1Item, LR1Comparator> kernel_items;
+
+      for(const LR1Item& item : item_set) {
+        if(item.is_kernel_item()) {
+          kernel_items.insert(item);
+        }
+      }
+
+      return kernel_items;
+    }
 };
 
 #endif /*  _SET_GENERATOR_HPP_ */
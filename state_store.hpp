@@ -0,0 +1,157 @@
+#ifndef _STATE_STORE_HPP_
+#define _STATE_STORE_HPP_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+// Appends value to out as an unsigned LEB128 varint
+void put_varint(std::string& out, uint64_t value) {
+  while(value >= 0x80) {
+    out += (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += (char)value;
+}
+
+// Reads an unsigned LEB128 varint from the size bytes of data at pos into value
+// Returns false if data ends first
+bool get_varint(const char* data, size_t size, size_t& pos, uint64_t& value) {
+  value = 0;
+  for(int shift = 0; shift < 64; shift += 7) {
+    if(pos >= size) {
+      return false;
+    }
+
+    unsigned char byte = data[pos++];
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool get_varint(const std::string& data, size_t& pos, uint64_t& value) {
+  return get_varint(data.data(), data.size(), pos, value);
+}
+
+/**
+ * An append-only file of records, read back through a memory map
+ *
+ * Used to move finished item sets out of memory once a generator goes
+ * over its memory budget. Each record is written once, with its length
+ * in front, and never changes, so a record is read straight out of the
+ * mapping without copying the file into memory. The mapping is only
+ * grown when a record past its end is read.
+ *
+ * The file is unlinked as soon as it is created, so it is removed
+ * when the store is closed, even if the process dies.
+ */
+class StateStore {
+  public:
+    // Creates the file in dir, the system temporary directory by default
+    // Throws std::runtime_error if it can't be created
+    StateStore(const std::filesystem::path& dir = std::filesystem::temp_directory_path()) {
+      std::string path = (dir / "state_store.XXXXXX").string();
+      fd = mkstemp(&path[0]);
+      if(fd < 0) {
+        throw std::runtime_error("failed to create state store in " + dir.string() + ": " + strerror(errno));
+      }
+      unlink(path.c_str());
+    }
+
+    StateStore(const StateStore&) = delete;
+    StateStore& operator=(const StateStore&) = delete;
+
+    ~StateStore() {
+      if(mapping != MAP_FAILED) {
+        munmap(mapping, mapped_size);
+      }
+      close(fd);
+    }
+
+    /**
+     * Appends record to the end of the file
+     * Returns the offset to read it back with
+     * Throws std::runtime_error if the write fails, e.g. on a full disk
+     */
+    uint64_t append(const std::string& record) {
+      std::string data;
+      put_varint(data, record.size());
+      data += record;
+
+      const uint64_t offset = file_size;
+      size_t written = 0;
+      while(written < data.size()) {
+        const ssize_t result = pwrite(fd, data.data() + written, data.size() - written, file_size + written);
+        if(result < 0) {
+          if(errno == EINTR) {
+            continue;
+          }
+          throw std::runtime_error(std::string("failed to write state store: ") + strerror(errno));
+        }
+        written += result;
+      }
+
+      file_size += data.size();
+      return offset;
+    }
+
+    /**
+     * Points data at the record appended at offset and sets size to its length
+     * data stays valid until the next read that grows the mapping
+     */
+    void read(uint64_t offset, const char*& data, size_t& size) {
+      if(offset >= mapped_size) {
+        remap();
+      }
+
+      size_t pos = offset;
+      uint64_t length = 0;
+      if(!get_varint((const char*)mapping, mapped_size, pos, length) || pos + length > mapped_size) {
+        throw std::runtime_error("corrupt state store record at " + std::to_string(offset));
+      }
+
+      data = (const char*)mapping + pos;
+      size = length;
+    }
+
+    // Returns the number of bytes written so far
+    uint64_t size() const {
+      return file_size;
+    }
+
+  private:
+    int fd = -1;
+    uint64_t file_size = 0;
+
+    void* mapping = MAP_FAILED;
+    size_t mapped_size = 0;
+
+    // Maps the whole file as it is now
+    void remap() {
+      if(mapping != MAP_FAILED) {
+        munmap(mapping, mapped_size);
+        mapping = MAP_FAILED;
+        mapped_size = 0;
+      }
+
+      mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+      if(mapping == MAP_FAILED) {
+        throw std::runtime_error(std::string("failed to map state store: ") + strerror(errno));
+      }
+      mapped_size = file_size;
+    }
+};
+
+#endif /* _STATE_STORE_HPP_ */
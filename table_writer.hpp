@@ -0,0 +1,287 @@
+#ifndef _TABLE_WRITER_HPP_
+#define _TABLE_WRITER_HPP_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Default size of the buffer rows are serialized into before being written
+const static size_t DEFAULT_TABLE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+/**
+ * Writes a parse table to a file one row at a time
+ *
+ * Rows are serialized into a large reusable buffer that is written out
+ * with a single sequential write whenever it fills up, so the text of the
+ * whole table never has to be in memory.
+ *
+ * With background set, full buffers are handed to a writer thread
+ * and the caller carries on filling a second buffer, which overlaps
+ * the file writes with generating the next rows.
+ *
+ * The output is a header line with the quoted table symbols separated
+ * by "," followed by one line per state with its actions separated by ", "
+ *
+ * Rows go to a temporary file next to the output, which only replaces
+ * the output once close succeeds. A table that fails part way, or a
+ * writer destroyed before close, leaves any earlier file at the path as
+ * it was instead of a partial table.
+ */
+class TableWriter {
+  public:
+    TableWriter(bool background = false, size_t buffer_size = DEFAULT_TABLE_BUFFER_SIZE) :
+      background(background),
+      buffer_size(buffer_size) {}
+
+    TableWriter(const std::string& path, bool background = false, size_t buffer_size = DEFAULT_TABLE_BUFFER_SIZE) :
+      TableWriter(background, buffer_size) {
+      open(path);
+    }
+
+    ~TableWriter() {
+      discard();
+    }
+
+    TableWriter(const TableWriter&) = delete;
+    TableWriter& operator=(const TableWriter&) = delete;
+
+    /**
+     * Opens path for writing, discarding any file that was already open
+     *
+     * The buffers are kept between files, so a writer reused for
+     * several tables only allocates them once
+     * Returns false if path could not be opened
+     */
+    bool open(const std::string& path) {
+      discard();
+      write_errno = 0;
+      done = false;
+
+      static std::atomic<uint64_t> counter(0);
+      this->path = path;
+      tmp_path = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+
+      fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if(fd < 0) {
+        write_errno = errno;
+        return false;
+      }
+
+      buffer.reserve(buffer_size);
+
+      if(background) {
+        pending.reserve(buffer_size);
+        writer_thread = std::thread(&TableWriter::run, this);
+      }
+
+      return true;
+    }
+
+    // Returns false if the output file could not be opened
+    bool is_open() const {
+      return fd >= 0;
+    }
+
+    // Describes the first error that occurred, or returns an empty string
+    std::string get_error() const {
+      return write_errno != 0 ? strerror(write_errno) : "";
+    }
+
+    // Writes the symbol header
+    // Symbols that aren't already quoted are quoted
+    void write_header(const std::vector<std::string>& symbols) {
+      for(int i = 0; i < symbols.size(); ++i) {
+        const std::string& symbol = symbols[i];
+
+        if(symbol.size() > 0 && symbol[0] != '\'' && symbol[symbol.size()-1] != '\'') {
+          buffer += '\'';
+          buffer += symbol;
+          buffer += '\'';
+        }
+        else {
+          buffer += symbol;
+        }
+
+        if(i < symbols.size() - 1) {
+          buffer += ',';
+        }
+      }
+
+      buffer += '\n';
+      flush_if_full();
+    }
+
+    // Writes the actions of the next state
+    void write_row(const std::vector<std::string>& row) {
+      int row_size = row.size();
+      for(int j = 0; j < row_size; ++j) {
+        buffer += row[j];
+
+        if(j < row_size - 1) {
+          buffer += ", ";
+        }
+      }
+
+      buffer += '\n';
+      flush_if_full();
+    }
+
+    /**
+     * Writes out anything still buffered, stops the writer thread,
+     * closes the file and moves it to the output path
+     * Returns false if any write failed, in which case the output
+     * path is left as it was
+     */
+    bool close() {
+      if(fd < 0) {
+        return write_errno == 0;
+      }
+
+      flush();
+      close_file();
+
+      if(write_errno == 0 && ::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        write_errno = errno;
+      }
+      if(write_errno != 0) {
+        ::unlink(tmp_path.c_str());
+      }
+
+      return write_errno == 0;
+    }
+
+    // Closes the file without writing what is buffered
+    // and removes it, leaving the output path as it was
+    void discard() {
+      if(fd < 0) {
+        return;
+      }
+
+      buffer.clear();
+      close_file();
+      ::unlink(tmp_path.c_str());
+    }
+
+  private:
+    int fd = -1;
+
+    // The output path and the file rows are written to until close
+    std::string path;
+    std::string tmp_path;
+
+    // Whether full buffers are written by a writer thread
+    bool background;
+
+    // Flush once the buffer holds this many bytes
+    size_t buffer_size;
+
+    // Rows are serialized here
+    std::string buffer;
+
+    // A full buffer waiting for the writer thread
+    // Only touched by the caller while has_pending is false
+    std::string pending;
+    bool has_pending = false;
+
+    // Set when the writer thread should exit
+    bool done = false;
+
+    // errno of the first failed write, 0 if there was none
+    int write_errno = 0;
+
+    std::thread writer_thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    // Stops the writer thread once it has written what it was handed
+    // and closes the file
+    void close_file() {
+      if(writer_thread.joinable()) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          done = true;
+        }
+        cv.notify_all();
+        writer_thread.join();
+      }
+
+      if(::close(fd) != 0 && write_errno == 0) {
+        write_errno = errno;
+      }
+      fd = -1;
+    }
+
+    void flush_if_full() {
+      if(buffer.size() >= buffer_size) {
+        flush();
+      }
+    }
+
+    // Writes the buffer out, or hands it to the writer thread
+    void flush() {
+      if(buffer.empty()) {
+        return;
+      }
+
+      if(!writer_thread.joinable()) {
+        write_all(buffer);
+        buffer.clear();
+        return;
+      }
+
+      // Wait for the previous buffer to be written then swap so
+      // the next rows go into the buffer it just emptied
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this]() { return !has_pending; });
+      buffer.swap(pending);
+      has_pending = true;
+      lock.unlock();
+      cv.notify_all();
+    }
+
+    // Writer thread loop
+    void run() {
+      std::unique_lock<std::mutex> lock(mutex);
+      while(true) {
+        cv.wait(lock, [this]() { return has_pending || done; });
+        if(!has_pending) {
+          return;
+        }
+
+        lock.unlock();
+        write_all(pending);
+        pending.clear();
+        lock.lock();
+
+        has_pending = false;
+        cv.notify_all();
+      }
+    }
+
+    // Writes all of data, retrying partial writes
+    void write_all(const std::string& data) {
+      size_t written = 0;
+      while(written < data.size() && write_errno == 0) {
+        ssize_t result = ::write(fd, data.data() + written, data.size() - written);
+        if(result < 0) {
+          if(errno != EINTR) {
+            write_errno = errno;
+          }
+          continue;
+        }
+
+        written += result;
+      }
+    }
+};
+
+#endif /* _TABLE_WRITER_HPP_ */